@@ -0,0 +1,299 @@
+#include "nm.h"
+
+#define AR_HDR_LEN 60
+
+/*
+** Layout of one `ar` member header (all fields are space-padded ASCII).
+*/
+typedef struct s_ar_hdr {
+	char name[16];
+	char date[12];
+	char uid[6];
+	char gid[6];
+	char mode[8];
+	char size[10];
+	char fmag[2];
+}	t_ar_hdr;
+
+typedef struct s_ar_member {
+	char	*name;
+	char	*data;
+	size_t	size;
+}	t_ar_member;
+
+typedef struct s_archive {
+	t_ar_member	*members;
+	int			count;
+	t_nm_flags	flags;
+	t_stats		*stats;
+}	t_archive;
+
+bool is_archive(const char *data, size_t size)
+{
+	return size >= AR_MAGIC_LEN && ft_strncmp(data, AR_MAGIC, AR_MAGIC_LEN) == 0;
+}
+
+/*
+** ar_decimal
+**
+** Description:
+**   Parses a space-padded decimal header field. Returns -1 if the field
+**   holds anything other than digits followed by spaces.
+*/
+static long long ar_decimal(const char *field, size_t len)
+{
+	long long	n = 0;
+	size_t		i = 0;
+
+	while (i < len && field[i] >= '0' && field[i] <= '9')
+	{
+		n = n * 10 + (field[i] - '0');
+		if (n > (1LL << 48))
+			return -1;
+		i++;
+	}
+	if (i == 0)
+		return -1;
+	while (i < len && field[i] == ' ')
+		i++;
+	return (i == len) ? n : -1;
+}
+
+static char *ar_strndup(const char *s, size_t len)
+{
+	char *dup = malloc(len + 1);
+
+	if (!dup)
+		return NULL;
+	memcpy(dup, s, len);
+	dup[len] = '\0';
+	return dup;
+}
+
+/*
+** ar_member_name
+**
+** Description:
+**   Resolves a member's name into a freshly allocated string:
+**   - GNU short names are terminated by '/' inside the 16-byte field;
+**   - GNU long names are "/<offset>" into the `//` table, where each entry
+**     ends with "/\n";
+**   - BSD names are "#1/<len>" and are stored at the start of the data,
+**     in which case `data`/`size` are advanced past them.
+*/
+static char *ar_member_name(t_ar_hdr *hdr, char *longnames, size_t longnames_size,
+	char **data, size_t *size)
+{
+	long long	off;
+	size_t		len;
+
+	if (hdr->name[0] == '/' && hdr->name[1] >= '0' && hdr->name[1] <= '9')
+	{
+		off = ar_decimal(hdr->name + 1, sizeof(hdr->name) - 1);
+		if (!longnames || off < 0 || (size_t)off >= longnames_size)
+			return NULL;
+		len = 0;
+		while (off + len < longnames_size && longnames[off + len] != '\n')
+			len++;
+		if (len > 0 && longnames[off + len - 1] == '/')
+			len--;
+		return ar_strndup(longnames + off, len);
+	}
+	if (ft_strncmp(hdr->name, "#1/", 3) == 0)
+	{
+		off = ar_decimal(hdr->name + 3, sizeof(hdr->name) - 3);
+		if (off < 0 || (size_t)off > *size)
+			return NULL;
+		len = 0;
+		while (len < (size_t)off && (*data)[len])
+			len++;
+		char *name = ar_strndup(*data, len);
+		*data += off;
+		*size -= off;
+		return name;
+	}
+	len = 0;
+	while (len < sizeof(hdr->name) && hdr->name[len] != '/')
+		len++;
+	// BSD short names have no '/' terminator, only trailing spaces
+	if (len == sizeof(hdr->name))
+		while (len > 0 && hdr->name[len - 1] == ' ')
+			len--;
+	return ar_strndup(hdr->name, len);
+}
+
+/*
+** ar_index
+**
+** Description:
+**   Splits the archive into its members. The symbol index (`/`, or
+**   `/SYM64/` for 64-bit offsets) and the GNU long-name table (`//`) are
+**   consumed here and not reported as members.
+**
+** Why:
+**   The index only lists global definitions and nm recomputes everything
+**   from the members' own symbol tables, so it is validated and skipped.
+**   The long-name table has to be known before any later member name can
+**   be resolved.
+*/
+static int ar_index(char *data, size_t size, t_archive *ar)
+{
+	size_t		pos = AR_MAGIC_LEN;
+	char		*longnames = NULL;
+	size_t		longnames_size = 0;
+	int			cap = 0;
+	t_ar_hdr	*hdr;
+	long long	msize;
+	char		*mdata;
+	size_t		mlen;
+
+	ar->members = NULL;
+	ar->count = 0;
+	while (pos + AR_HDR_LEN <= size)
+	{
+		hdr = (t_ar_hdr *)(data + pos);
+		msize = ar_decimal(hdr->size, sizeof(hdr->size));
+		if (hdr->fmag[0] != '`' || hdr->fmag[1] != '\n' || msize < 0
+			|| (size_t)msize > size - pos - AR_HDR_LEN)
+			return -1;
+		mdata = data + pos + AR_HDR_LEN;
+		mlen = msize;
+		pos += AR_HDR_LEN + msize + (msize & 1);
+
+		if (ft_strncmp(hdr->name, "/               ", 16) == 0
+			|| ft_strncmp(hdr->name, "/SYM64/         ", 16) == 0
+			|| ft_strncmp(hdr->name, "__.SYMDEF", 9) == 0)
+			continue;
+		if (ft_strncmp(hdr->name, "//              ", 16) == 0)
+		{
+			longnames = mdata;
+			longnames_size = mlen;
+			continue;
+		}
+		if (ar->count == cap)
+		{
+			cap = cap ? cap * 2 : 64;
+			t_ar_member *grown = realloc(ar->members, sizeof(t_ar_member) * cap);
+			if (!grown)
+				return -1;
+			ar->members = grown;
+		}
+		ar->members[ar->count].name = ar_member_name(hdr, longnames, longnames_size, &mdata, &mlen);
+		if (!ar->members[ar->count].name)
+			return -1;
+		ar->members[ar->count].data = mdata;
+		ar->members[ar->count].size = mlen;
+		ar->count++;
+	}
+	return 0;
+}
+
+/*
+** member_task
+**
+** Description:
+**   Prints one member's `\nmember:\n` header and its symbols. Members that
+**   are not objects only produce a warning, like binutils nm. Nothing a
+**   member allocates in the arena outlives it. Members sit at even offsets
+**   of the archive: one that is not 8-byte aligned is copied into the
+**   arena first, as the ELF readers load its headers through typed
+**   pointers. With --xref the member is
+**   registered as a file of its own instead (see xref.c). The other
+**   formats name the member on their own (see format.c).
+*/
+static int member_task(void *ctx, int index)
+{
+	t_archive	*ar = ctx;
+	t_ar_member	*m = &ar->members[index];
+	char		*data = m->data;
+	t_nm_flags	flags = ar->flags;
+	t_stats		member;
+	int			ret;
+
+	if (!(m->size >= SELFMAG && data[EI_MAG0] == ELFMAG0 && data[EI_MAG1] == ELFMAG1
+		&& data[EI_MAG2] == ELFMAG2 && data[EI_MAG3] == ELFMAG3))
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, m->name);
+		ft_putstr_fd(2, "': File format not recognized\n");
+		return 0;
+	}
+	if (flags.xref)
+	{
+		flags.xref_file = xref_member(flags.xref_table, flags.xref_file, index, m->name);
+		if (flags.xref_file == XREF_NONE)
+		{
+			ft_putstr_fd(2, "Memory allocation failed\n");
+			return 1;
+		}
+	}
+	else if (flags.format == FORMAT_BSD)
+	{
+		ft_putstr_fd(1, "\n");
+		ft_putstr_fd(1, m->name);
+		ft_putstr_fd(1, ":\n");
+	}
+	flags.member_name = m->name;
+	if ((uintptr_t)data & 7)
+	{
+		if (!(data = arena_alloc(m->size)))
+		{
+			ft_putstr_fd(2, "Memory allocation failed\n");
+			return 1;
+		}
+		memcpy(data, m->data, m->size);
+	}
+	if (!ar->stats || stats_current())
+		ret = nm_buffer(data, m->size, m->name, flags);
+	else
+	{
+		// a -j worker: accounted on its own, then added to the archive's --stats
+		stats_begin(&member, m->name);
+		ret = nm_buffer(data, m->size, m->name, flags);
+		stats_join(&member, ar->stats);
+	}
+	arena_reset();
+	return ret;
+}
+
+/*
+** handle_archive
+**
+** Description:
+**   Lists every object of a static library, in member order, straight from
+**   the archive's mapping. With -j the members are parsed in parallel.
+*/
+int handle_archive(char *data, size_t size, t_nm_flags flags)
+{
+	t_archive	ar;
+	int			ret = 0;
+
+	if (flags.resolve)
+	{
+		ft_putstr_fd(2, "ft_nm: '--resolve' needs an ELF file, not an archive\n");
+		return 1;
+	}
+	ar.flags = flags;
+	// the cache keys whole files, members are not stored on their own
+	ar.flags.cache = NULL;
+	ar.stats = stats_current();
+	if (ar_index(data, size, &ar) < 0)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, flags.file_name);
+		ft_putstr_fd(2, "': Malformed archive\n");
+		ret = 1;
+	}
+	else if (flags.jobs > 1 && ar.count > 1 && !out_capture_err())
+		ret = run_jobs(ar.count, flags.jobs, member_task, &ar);
+	else
+	{
+		for (int i = 0; i < ar.count; i++)
+			if (member_task(&ar, i) != 0)
+				ret = 1;
+	}
+	for (int i = 0; i < ar.count; i++)
+		free(ar.members[i].name);
+	free(ar.members);
+	return ret;
+}
@@ -0,0 +1,140 @@
+#include "nm.h"
+
+/*
+** Arena
+**
+** Description:
+**   Bump allocator for everything that lives exactly as long as one input
+**   file: the t_sym array, the per-section letters, the version table and
+**   the sort keys and scratch. Each thread that lists files owns one arena
+**   (main, every -j worker, every --serve client) and selects it with
+**   arena_use. Allocations are never freed one by one; the arena is reset
+**   once the file (or archive member) is done. When an allocation does not
+**   fit, a new block at least as large as everything reserved so far is
+**   chained in, and a reset then merges the blocks into a single one.
+**
+** Why:
+**   Freeing a symbol table sized for the whole file after every file and
+**   allocating the next one costs a large allocation, a storm of page
+**   faults and a release for each input of a sysroot-wide run. The arena's
+**   memory stays mapped from one file to the next, so its size settles to
+**   what the largest file needs.
+*/
+
+#define ARENA_ALIGN 16
+#define ARENA_HDR ((sizeof(t_arena_block) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static __thread t_arena *g_arena = NULL;
+
+void arena_init(t_arena *a)
+{
+	a->block = NULL;
+	a->reserved = 0;
+	a->used = 0;
+	a->high = 0;
+}
+
+void arena_use(t_arena *a)
+{
+	g_arena = a;
+}
+
+t_arena *arena_current(void)
+{
+	return g_arena;
+}
+
+/*
+** arena_grow
+**
+** Description:
+**   Chains in a block of at least `size` bytes, doubling what the arena
+**   has reserved. Returns -1 if the allocation failed.
+*/
+static int arena_grow(t_arena *a, size_t size)
+{
+	t_arena_block *b;
+
+	if (size < a->reserved)
+		size = a->reserved;
+	if (size < ARENA_MIN_BLOCK)
+		size = ARENA_MIN_BLOCK;
+	b = malloc(ARENA_HDR + size);
+	if (!b)
+		return -1;
+	b->prev = a->block;
+	b->size = size;
+	b->used = 0;
+	a->block = b;
+	a->reserved += size;
+	return 0;
+}
+
+/*
+** arena_alloc
+**
+** Description:
+**   Returns `size` bytes, 16-byte aligned, from the calling thread's arena,
+**   or NULL if it has none or memory is exhausted.
+*/
+void *arena_alloc(size_t size)
+{
+	t_arena	*a = g_arena;
+	void	*p;
+
+	if (!a)
+		return NULL;
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if ((!a->block || a->block->size - a->block->used < size) && arena_grow(a, size) < 0)
+		return NULL;
+	p = (char *)a->block + ARENA_HDR + a->block->used;
+	a->block->used += size;
+	a->used += size;
+	if (a->used > a->high)
+		a->high = a->used;
+	return p;
+}
+
+static void arena_release(t_arena *a)
+{
+	t_arena_block *prev;
+
+	while (a->block)
+	{
+		prev = a->block->prev;
+		free(a->block);
+		a->block = prev;
+	}
+	a->reserved = 0;
+}
+
+/*
+** arena_reset
+**
+** Description:
+**   Forgets every allocation of the calling thread's arena but keeps its
+**   memory. Several blocks are merged into one of their total size.
+*/
+void arena_reset(void)
+{
+	t_arena	*a = g_arena;
+	size_t	reserved;
+
+	if (!a || !a->block)
+		return;
+	a->used = 0;
+	if (!a->block->prev)
+	{
+		a->block->used = 0;
+		return;
+	}
+	reserved = a->reserved;
+	arena_release(a);
+	arena_grow(a, reserved);
+}
+
+void arena_free(t_arena *a)
+{
+	arena_release(a);
+	a->used = 0;
+}
@@ -0,0 +1,392 @@
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+** gen_elf
+**
+** Description:
+**   Writes a synthetic relocatable ELF object for benchmarks: ELF32 or
+**   ELF64, little- or big-endian, with a symbol table of any size whose
+**   name lengths, shared-prefix ratio, bindings and types are chosen on
+**   the command line. The same seed always gives the same file.
+**
+**   usage: gen_elf -o FILE [-c 32|64] [-e le|be] [-n COUNT] [-l MIN:MAX]
+**                  [-p PREFIX_RATIO] [-b LOCAL:GLOBAL:WEAK]
+**                  [-t FUNC:OBJECT:NOTYPE] [-u UNDEF_RATIO] [-s SEED]
+**
+** Why:
+**   The objects in test/ hold a few dozen symbols; sorting and printing
+**   regressions only show on tables of 10^5 to 10^7 entries, with the
+**   long shared prefixes of mangled C++ names.
+*/
+
+#define SEC_TEXT 1
+#define SEC_DATA 2
+#define SEC_BSS 3
+#define SEC_RODATA 4
+#define SEC_SYMTAB 5
+#define SEC_STRTAB 6
+#define SEC_SHSTRTAB 7
+#define SEC_COUNT 8
+#define SEC_BYTES 4096
+#define NPREFIXES 16
+
+typedef struct s_gen {
+	int			bits;
+	int			swap;
+	uint64_t	count;
+	int			len_min;
+	int			len_max;
+	double		prefix_ratio;
+	double		bind[3];
+	double		type[3];
+	double		undef_ratio;
+	uint64_t	seed;
+	const char	*out;
+}	t_gen;
+
+typedef struct s_strtab {
+	char		*buf;
+	size_t		len;
+	size_t		cap;
+}	t_strtab;
+
+static uint64_t g_rng;
+
+static uint64_t rnd(void)
+{
+	g_rng ^= g_rng >> 12;
+	g_rng ^= g_rng << 25;
+	g_rng ^= g_rng >> 27;
+	return g_rng * 0x2545f4914f6cdd1dULL;
+}
+
+static double rnd_unit(void)
+{
+	return (rnd() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+** pick
+**
+** Description:
+**   Index 0..2 drawn with the three (not necessarily normalized) weights.
+*/
+static int pick(const double *w)
+{
+	double x = rnd_unit() * (w[0] + w[1] + w[2]);
+
+	if (x < w[0])
+		return 0;
+	return (x < w[0] + w[1]) ? 1 : 2;
+}
+
+/*
+** put
+**
+** Description:
+**   Stores the low `size` bytes of `v` at `dst` in the output byte order.
+*/
+static void put(t_gen *g, unsigned char *dst, uint64_t v, int size)
+{
+	for (int i = 0; i < size; i++)
+		dst[g->swap ? size - 1 - i : i] = (v >> (8 * i)) & 0xff;
+}
+
+static size_t str_add(t_strtab *st, const char *s, size_t len)
+{
+	size_t off = st->len;
+
+	if (st->len + len + 1 > st->cap)
+	{
+		st->cap = (st->cap ? st->cap * 2 : 1 << 20) + len + 1;
+		st->buf = realloc(st->buf, st->cap);
+		if (!st->buf)
+		{
+			perror("gen_elf");
+			exit(1);
+		}
+	}
+	memcpy(st->buf + st->len, s, len);
+	st->buf[st->len + len] = '\0';
+	st->len += len + 1;
+	return off;
+}
+
+/*
+** make_name
+**
+** Description:
+**   Random identifier of MIN..MAX characters; with the prefix ratio's
+**   probability it starts with one of a few long mangled-looking prefixes.
+*/
+static size_t make_name(t_gen *g, char *name, char prefixes[NPREFIXES][48])
+{
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+	size_t len = g->len_min + rnd() % (g->len_max - g->len_min + 1);
+	size_t i = 0;
+
+	if (rnd_unit() < g->prefix_ratio)
+	{
+		char *p = prefixes[rnd() % NPREFIXES];
+		size_t plen = strlen(p);
+		memcpy(name, p, plen);
+		i = plen;
+		len += plen;
+	}
+	else
+		name[i++] = chars[rnd() % 52];
+	while (i < len)
+		name[i++] = chars[rnd() % (sizeof(chars) - 1)];
+	name[len] = '\0';
+	return len;
+}
+
+/*
+** write_sym
+**
+** Description:
+**   Encodes one symbol table entry in the output class and byte order.
+*/
+static void write_sym(t_gen *g, FILE *f, uint32_t name, uint64_t value, uint64_t size,
+	int bind, int type, uint16_t shndx)
+{
+	unsigned char e[24];
+	unsigned char info = (bind << 4) | type;
+
+	memset(e, 0, sizeof(e));
+	if (g->bits == 64)
+	{
+		put(g, e, name, 4);
+		e[4] = info;
+		put(g, e + 6, shndx, 2);
+		put(g, e + 8, value, 8);
+		put(g, e + 16, size, 8);
+		fwrite(e, 24, 1, f);
+	}
+	else
+	{
+		put(g, e, name, 4);
+		put(g, e + 4, value, 4);
+		put(g, e + 8, size, 4);
+		e[12] = info;
+		put(g, e + 14, shndx, 2);
+		fwrite(e, 16, 1, f);
+	}
+}
+
+static void write_shdr(t_gen *g, FILE *f, uint32_t name, uint32_t type, uint64_t flags,
+	uint64_t offset, uint64_t size, uint32_t link, uint32_t info, uint64_t entsize)
+{
+	unsigned char s[64];
+	int w = g->bits / 8;
+
+	memset(s, 0, sizeof(s));
+	put(g, s, name, 4);
+	put(g, s + 4, type, 4);
+	put(g, s + 8, flags, w);
+	// sh_addr stays 0
+	put(g, s + 8 + 2 * w, offset, w);
+	put(g, s + 8 + 3 * w, size, w);
+	put(g, s + 8 + 4 * w, link, 4);
+	put(g, s + 12 + 4 * w, info, 4);
+	put(g, s + 16 + 4 * w, (g->bits == 64) ? 8 : 4, w);
+	put(g, s + 16 + 5 * w, entsize, w);
+	fwrite(s, 16 + 6 * w, 1, f);
+}
+
+static void write_ehdr(t_gen *g, FILE *f, uint64_t shoff)
+{
+	unsigned char e[64];
+	int w = g->bits / 8;
+	int ehsize = (g->bits == 64) ? 64 : 52;
+
+	memset(e, 0, sizeof(e));
+	memcpy(e, ELFMAG, SELFMAG);
+	e[EI_CLASS] = (g->bits == 64) ? ELFCLASS64 : ELFCLASS32;
+	e[EI_DATA] = (g->swap ^ (*(uint16_t *)"\1\0" != 1)) ? ELFDATA2MSB : ELFDATA2LSB;
+	e[EI_VERSION] = EV_CURRENT;
+	put(g, e + 16, ET_REL, 2);
+	put(g, e + 18, (g->bits == 64) ? EM_X86_64 : EM_386, 2);
+	put(g, e + 20, EV_CURRENT, 4);
+	// e_entry and e_phoff stay 0
+	put(g, e + 24 + 2 * w, shoff, w);
+	// e_flags, e_phentsize and e_phnum stay 0
+	put(g, e + 28 + 3 * w, ehsize, 2);
+	put(g, e + 34 + 3 * w, 16 + 6 * w, 2);
+	put(g, e + 36 + 3 * w, SEC_COUNT, 2);
+	put(g, e + 38 + 3 * w, SEC_SHSTRTAB, 2);
+	fwrite(e, ehsize, 1, f);
+}
+
+static int parse_pair(const char *s, int *a, int *b)
+{
+	return sscanf(s, "%d:%d", a, b) == 2 && *a >= 1 && *b >= *a && *b < 4000 ? 0 : -1;
+}
+
+static int parse_triple(const char *s, double *w)
+{
+	return sscanf(s, "%lf:%lf:%lf", &w[0], &w[1], &w[2]) == 3
+		&& w[0] >= 0 && w[1] >= 0 && w[2] >= 0 && w[0] + w[1] + w[2] > 0 ? 0 : -1;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: gen_elf -o FILE [-c 32|64] [-e le|be] [-n COUNT] [-l MIN:MAX]\n"
+		"               [-p PREFIX_RATIO] [-b LOCAL:GLOBAL:WEAK] [-t FUNC:OBJECT:NOTYPE]\n"
+		"               [-u UNDEF_RATIO] [-s SEED]\n");
+	exit(2);
+}
+
+static void parse_args(int argc, char **argv, t_gen *g)
+{
+	int opt;
+	int little = (*(uint16_t *)"\1\0" == 1);
+
+	*g = (t_gen){64, 0, 100000, 4, 32, 0.3, {0.2, 0.7, 0.1}, {0.6, 0.3, 0.1}, 0.1, 42, NULL};
+	while ((opt = getopt(argc, argv, "o:c:e:n:l:p:b:t:u:s:")) != -1)
+	{
+		if (opt == 'o')
+			g->out = optarg;
+		else if (opt == 'c' && (atoi(optarg) == 32 || atoi(optarg) == 64))
+			g->bits = atoi(optarg);
+		else if (opt == 'e' && (strcmp(optarg, "le") == 0 || strcmp(optarg, "be") == 0))
+			g->swap = (strcmp(optarg, "le") == 0) != little;
+		else if (opt == 'n' && strtoull(optarg, NULL, 10) > 0)
+			g->count = strtoull(optarg, NULL, 10);
+		else if (opt == 'l' && parse_pair(optarg, &g->len_min, &g->len_max) == 0)
+			;
+		else if (opt == 'p' && atof(optarg) >= 0 && atof(optarg) <= 1)
+			g->prefix_ratio = atof(optarg);
+		else if (opt == 'b' && parse_triple(optarg, g->bind) == 0)
+			;
+		else if (opt == 't' && parse_triple(optarg, g->type) == 0)
+			;
+		else if (opt == 'u' && atof(optarg) >= 0 && atof(optarg) <= 1)
+			g->undef_ratio = atof(optarg);
+		else if (opt == 's')
+			g->seed = strtoull(optarg, NULL, 10);
+		else
+			usage();
+	}
+	if (!g->out)
+		usage();
+}
+
+int main(int argc, char **argv)
+{
+	static const char shstrtab[] = "\0.text\0.data\0.bss\0.rodata\0.symtab\0.strtab\0.shstrtab";
+	static const uint32_t shname[SEC_COUNT] = {0, 1, 7, 13, 18, 26, 34, 42};
+	static const int bindings[3] = {STB_LOCAL, STB_GLOBAL, STB_WEAK};
+	static const int types[3] = {STT_FUNC, STT_OBJECT, STT_NOTYPE};
+	char prefixes[NPREFIXES][48];
+	char name[4096 + 48];
+	t_strtab strtab = {NULL, 0, 0};
+	t_gen g;
+	FILE *f;
+
+	parse_args(argc, argv, &g);
+	g_rng = g.seed * 0x9e3779b97f4a7c15ULL + 1;
+	for (int i = 0; i < NPREFIXES; i++)
+		snprintf(prefixes[i], sizeof(prefixes[i]), "_ZN5bench%d6detail%dmodule%dImpl%d", i, i * 7, i * 13, i * 31);
+
+	int ehsize = (g.bits == 64) ? 64 : 52;
+	size_t entsize = (g.bits == 64) ? 24 : 16;
+	// null, file and four section symbols come first, then the generated ones
+	uint64_t nlocal_fixed = 6;
+	uint64_t nlocal = 0;
+	int *bind = malloc(sizeof(int) * g.count);
+	if (!bind)
+	{
+		perror("gen_elf");
+		return 1;
+	}
+	for (uint64_t i = 0; i < g.count; i++)
+	{
+		bind[i] = pick(g.bind);
+		nlocal += (bind[i] == 0);
+	}
+	uint64_t nsyms = nlocal_fixed + g.count;
+	uint64_t text_off = ehsize;
+	uint64_t symtab_off = text_off + 3 * SEC_BYTES;
+	symtab_off = (symtab_off + 7) & ~7ULL;
+
+	f = fopen(g.out, "wb");
+	if (!f)
+	{
+		perror(g.out);
+		return 1;
+	}
+	setvbuf(f, NULL, _IOFBF, 1 << 20);
+	write_ehdr(&g, f, 0);
+	{
+		unsigned char zero[SEC_BYTES] = {0};
+		for (int i = 0; i < 3; i++)
+			fwrite(zero, SEC_BYTES, 1, f);
+		fwrite(zero, symtab_off - (text_off + 3 * SEC_BYTES), 1, f);
+	}
+
+	str_add(&strtab, "", 0);
+	write_sym(&g, f, 0, 0, 0, 0, 0, 0);
+	write_sym(&g, f, str_add(&strtab, "bench.c", 7), 0, 0, STB_LOCAL, STT_FILE, SHN_ABS);
+	for (int s = SEC_TEXT; s <= SEC_RODATA; s++)
+		write_sym(&g, f, 0, 0, 0, STB_LOCAL, STT_SECTION, s);
+	// locals first, as the ELF spec requires, then globals and weaks
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (uint64_t i = 0; i < g.count; i++)
+		{
+			if ((bind[i] == 0) != (pass == 0))
+				continue;
+			int type = types[pick(g.type)];
+			uint16_t shndx;
+			if (bind[i] != 0 && rnd_unit() < g.undef_ratio)
+			{
+				shndx = SHN_UNDEF;
+				type = STT_NOTYPE;
+			}
+			else if (type == STT_FUNC)
+				shndx = SEC_TEXT;
+			else
+				shndx = SEC_DATA + rnd() % 3;
+			size_t len = make_name(&g, name, prefixes);
+			uint64_t value = shndx == SHN_UNDEF ? 0 : (rnd() % SEC_BYTES) & ~3ULL;
+			write_sym(&g, f, str_add(&strtab, name, len), value, 16, bindings[bind[i]], type, shndx);
+		}
+	}
+	free(bind);
+
+	uint64_t strtab_off = symtab_off + nsyms * entsize;
+	fwrite(strtab.buf, strtab.len, 1, f);
+	uint64_t shstrtab_off = strtab_off + strtab.len;
+	fwrite(shstrtab, sizeof(shstrtab), 1, f);
+	uint64_t shoff = shstrtab_off + sizeof(shstrtab);
+	uint64_t pad = (8 - shoff % 8) % 8;
+	fwrite("\0\0\0\0\0\0\0", pad, 1, f);
+	shoff += pad;
+
+	write_shdr(&g, f, 0, SHT_NULL, 0, 0, 0, 0, 0, 0);
+	write_shdr(&g, f, shname[SEC_TEXT], SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text_off, SEC_BYTES, 0, 0, 0);
+	write_shdr(&g, f, shname[SEC_DATA], SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, text_off + SEC_BYTES, SEC_BYTES, 0, 0, 0);
+	write_shdr(&g, f, shname[SEC_BSS], SHT_NOBITS, SHF_ALLOC | SHF_WRITE, text_off + 2 * SEC_BYTES, SEC_BYTES, 0, 0, 0);
+	write_shdr(&g, f, shname[SEC_RODATA], SHT_PROGBITS, SHF_ALLOC, text_off + 2 * SEC_BYTES, SEC_BYTES, 0, 0, 0);
+	write_shdr(&g, f, shname[SEC_SYMTAB], SHT_SYMTAB, 0, symtab_off, nsyms * entsize,
+		SEC_STRTAB, nlocal_fixed + nlocal, entsize);
+	write_shdr(&g, f, shname[SEC_STRTAB], SHT_STRTAB, 0, strtab_off, strtab.len, 0, 0, 0);
+	write_shdr(&g, f, shname[SEC_SHSTRTAB], SHT_STRTAB, 0, shstrtab_off, sizeof(shstrtab), 0, 0, 0);
+
+	// now that the section header offset is known
+	fseek(f, 0, SEEK_SET);
+	write_ehdr(&g, f, shoff);
+	free(strtab.buf);
+	if (fclose(f) != 0)
+	{
+		perror(g.out);
+		return 1;
+	}
+	return 0;
+}
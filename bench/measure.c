@@ -0,0 +1,133 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+** measure
+**
+** Description:
+**   Runs a command and appends one JSON object describing the run to FILE:
+**   wall, user and system time in milliseconds, peak RSS in KiB, the exit
+**   status, and with -s the number of system calls it made (counted with
+**   ptrace, in a run of its own since tracing slows every syscall down).
+**
+**   usage: measure [-s] -o FILE -- command [args...]
+**
+** Why:
+**   The bench runner needs the same figures for ft_nm and binutils nm
+**   without depending on GNU time, strace or perf being installed.
+*/
+
+static double ms(struct timeval tv)
+{
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/*
+** count_syscalls
+**
+** Description:
+**   Lets a PTRACE_TRACEME child run to completion, stopping it at every
+**   syscall entry and exit. Returns the number of syscalls and leaves the
+**   child's wait status in `*status`.
+*/
+static long count_syscalls(pid_t pid, int *status)
+{
+	long stops = 0;
+	int sig = 0;
+
+	// first stop: the SIGTRAP raised by execve
+	if (waitpid(pid, status, 0) < 0 || !WIFSTOPPED(*status))
+		return -1;
+	ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL);
+	while (1)
+	{
+		if (ptrace(PTRACE_SYSCALL, pid, 0, sig) < 0)
+			return -1;
+		if (waitpid(pid, status, 0) < 0)
+			return -1;
+		if (WIFEXITED(*status) || WIFSIGNALED(*status))
+			break;
+		sig = 0;
+		if (WSTOPSIG(*status) == (SIGTRAP | 0x80))
+			stops++;
+		else
+			sig = WSTOPSIG(*status);
+	}
+	// entry and exit stops, the final exit_group only has an entry
+	return (stops + 1) / 2;
+}
+
+int main(int argc, char **argv)
+{
+	struct timespec	start;
+	struct timespec	end;
+	struct rusage	ru;
+	const char		*out = NULL;
+	long			syscalls = -1;
+	int				trace = 0;
+	int				status = 0;
+	int				opt;
+	pid_t			pid;
+	FILE			*f;
+
+	while ((opt = getopt(argc, argv, "so:")) != -1)
+	{
+		if (opt == 's')
+			trace = 1;
+		else if (opt == 'o')
+			out = optarg;
+		else
+			break;
+	}
+	if (!out || optind >= argc)
+	{
+		fprintf(stderr, "usage: measure [-s] -o FILE -- command [args...]\n");
+		return 2;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pid = fork();
+	if (pid < 0)
+	{
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0)
+	{
+		if (trace)
+			ptrace(PTRACE_TRACEME, 0, 0, 0);
+		execvp(argv[optind], argv + optind);
+		perror(argv[optind]);
+		_exit(127);
+	}
+	if (trace)
+		syscalls = count_syscalls(pid, &status);
+	else
+		waitpid(pid, &status, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	getrusage(RUSAGE_CHILDREN, &ru);
+
+	f = fopen(out, "a");
+	if (!f)
+	{
+		perror(out);
+		return 1;
+	}
+	fprintf(f, "{\"wall_ms\":%.3f,\"user_ms\":%.3f,\"sys_ms\":%.3f,\"maxrss_kb\":%ld,",
+		(end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6,
+		ms(ru.ru_utime), ms(ru.ru_stime), ru.ru_maxrss);
+	if (syscalls >= 0)
+		fprintf(f, "\"syscalls\":%ld,", syscalls);
+	else
+		fprintf(f, "\"syscalls\":null,");
+	fprintf(f, "\"status\":%d}\n", WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+	fclose(f);
+	return 0;
+}
@@ -0,0 +1,94 @@
+#!/bin/bash
+# Benchmarks ft_nm against binutils nm on synthetic objects (see gen_elf.c).
+# Every (object, mode, tool) run appends one JSON line to $BENCH_RESULTS.
+#
+# Settings (environment):
+#   BENCH_SIZES     symbol counts                 (default: 1000 100000 1000000)
+#   BENCH_FORMATS   class+byte order              (default: 64le 64be 32le 32be)
+#   BENCH_MODES     ';'-separated flag sets       (default: ;-r;-p;-g;-u;-a;--stream)
+#   BENCH_REPEAT    timed runs, the fastest kept  (default: 3)
+#   BENCH_NAMELEN   name length MIN:MAX           (default: 4:32)
+#   BENCH_PREFIX    shared-prefix ratio           (default: 0.3)
+#   BENCH_BIND      LOCAL:GLOBAL:WEAK weights     (default: 0.2:0.7:0.1)
+#   BENCH_TYPE      FUNC:OBJECT:NOTYPE weights    (default: 0.6:0.3:0.1)
+#   BENCH_UNDEF     undefined ratio of globals    (default: 0.1)
+#   BENCH_NM        reference nm, empty to skip   (default: nm)
+#   BENCH_RESULTS   results file                  (default: bench/results.jsonl)
+
+cd "$(dirname "$0")/.." || exit 1
+
+SIZES=${BENCH_SIZES:-"1000 100000 1000000"}
+FORMATS=${BENCH_FORMATS:-"64le 64be 32le 32be"}
+MODES=${BENCH_MODES-";-r;-p;-g;-u;-a;--stream"}
+REPEAT=${BENCH_REPEAT:-3}
+NAMELEN=${BENCH_NAMELEN:-4:32}
+PREFIX=${BENCH_PREFIX:-0.3}
+BIND=${BENCH_BIND:-0.2:0.7:0.1}
+TYPE=${BENCH_TYPE:-0.6:0.3:0.1}
+UNDEF=${BENCH_UNDEF:-0.1}
+NM=${BENCH_NM-nm}
+RESULTS=${BENCH_RESULTS:-bench/results.jsonl}
+
+DATA=bench/data
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+mkdir -p "$DATA"
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+DATE=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+IFS=';' read -r -a MODE_LIST <<< "$MODES"
+[ -z "$MODES" ] && MODE_LIST=("")
+[[ "$MODES" == *";" ]] && MODE_LIST+=("")
+
+# fastest of $REPEAT timed runs, then one traced run for the syscall count
+measure() {
+	local out=$1; shift
+	rm -f "$TMP/runs"
+	for _ in $(seq "$REPEAT"); do
+		bench/measure -o "$TMP/runs" -- "$@" > "$out" 2>/dev/null
+	done
+	rm -f "$TMP/traced"
+	bench/measure -s -o "$TMP/traced" -- "$@" > /dev/null 2>&1
+	local syscalls
+	syscalls=$(sed -n 's/.*"syscalls":\([^,]*\),.*/\1/p' "$TMP/traced")
+	sort -t: -k2 -n "$TMP/runs" | head -1 | sed "s/\"syscalls\":null/\"syscalls\":${syscalls:-null}/"
+}
+
+# record TOOL MODE FORMAT FILE MEASUREMENT SYMBOLS MATCH
+record() {
+	local wall
+	wall=$(sed -n 's/.*"wall_ms":\([0-9.]*\).*/\1/p' <<< "$5")
+	local rate
+	rate=$(awk -v n="$6" -v ms="$wall" 'BEGIN { printf "%.0f", (ms > 0) ? n * 1000 / ms : 0 }')
+	printf '{"date":"%s","commit":"%s","tool":"%s","mode":"%s","class":%s,"endian":"%s","symbols":%s,"file_bytes":%s,%s,"symbols_per_sec":%s,"matches_nm":%s}\n' \
+		"$DATE" "$COMMIT" "$1" "$2" "${3%??}" "${3#??}" "$6" "$(stat -c %s "$4")" \
+		"$(sed 's/^{//; s/}$//' <<< "$5")" "$rate" "$7" >> "$RESULTS"
+}
+
+for size in $SIZES; do
+	for fmt in $FORMATS; do
+		file="$DATA/s${size}_${fmt}_l${NAMELEN/:/-}_p${PREFIX}_b${BIND//:/-}_t${TYPE//:/-}_u${UNDEF}.o"
+		if [ ! -f "$file" ]; then
+			bench/gen_elf -o "$file" -c "${fmt%??}" -e "${fmt#??}" -n "$size" -l "$NAMELEN" \
+				-p "$PREFIX" -b "$BIND" -t "$TYPE" -u "$UNDEF" || exit 1
+		fi
+		for mode in "${MODE_LIST[@]}"; do
+			# shellcheck disable=SC2086
+			ft=$(LC_ALL=C measure "$TMP/ft.out" ./ft_nm $mode "$file")
+			symbols=$(wc -l < "$TMP/ft.out")
+			match=null
+			if [ -n "$NM" ]; then
+				ref_mode=$mode
+				[ "$mode" = "--stream" ] && ref_mode=""
+				# shellcheck disable=SC2086
+				ref=$(LC_ALL=C measure "$TMP/nm.out" "$NM" $ref_mode "$file")
+				cmp -s "$TMP/ft.out" "$TMP/nm.out" && match=true || match=false
+				record "$NM" "$mode" "$fmt" "$file" "$ref" "$(wc -l < "$TMP/nm.out")" null
+			fi
+			record ft_nm "$mode" "$fmt" "$file" "$ft" "$symbols" "$match"
+			printf '%-8s %9s %-10s %s\n' "$fmt" "$size" "${mode:-default}" \
+				"$(sed -n 's/.*"wall_ms":\([0-9.]*\).*"maxrss_kb":\([0-9]*\).*"syscalls":\([^,]*\).*/ft_nm \1 ms, \2 KiB, \3 syscalls/p' <<< "$ft") (matches nm: $match)"
+		done
+	done
+done
+echo "results appended to $RESULTS"
@@ -0,0 +1,505 @@
+#include "nm.h"
+#include <dirent.h>
+#include <time.h>
+
+/*
+** Symbol index cache (--cache-dir DIR)
+**
+** Description:
+**   The sorted, classified symbol list of each input file is kept in DIR as
+**   one small binary index, named after the file's (dev, inode, size,
+**   mtime_ns) and the flags that change which symbols are listed or how
+**   they are ordered (-a, -p, -r, -D). A later run on the unchanged file
+**   maps the index and prints from it without opening the ELF at all.
+**   -g and -u only filter at print time, so they share one index.
+**
+**   Layout (host byte order, the cache is never shared between machines):
+**     t_cache_hdr | t_cache_rec[count] | strings (NUL-terminated)
+**
+** Why:
+**   CI reruns ft_nm over the same unchanged toolchain libraries, and every
+**   run used to re-parse and re-sort them. Indexes are written to a
+**   temporary file and renamed into place, so concurrent runs (and -j
+**   workers) never see a partial one; the directory is kept under a size
+**   bound by evicting the least recently used indexes. The directory is
+**   only scanned when the bytes stored since the last scan may have pushed
+**   it past the bound (or every CACHE_SCAN_EVERY stores, for other runs
+**   sharing it), and eviction goes down to 7/8 of the bound, so a cold
+**   run does not rescan it after every file.
+*/
+
+#define CACHE_MAGIC "FTNMIDX1"
+#define CACHE_EXT ".nmidx"
+#define CACHE_NO_VERSION 0xffffffffu
+#define CACHE_CHUNK 1024
+// the directory is rescanned at least every CACHE_SCAN_EVERY stores
+#define CACHE_SCAN_EVERY 256
+// temporary files older than this were left by a killed run
+#define CACHE_TMP_AGE 3600
+
+typedef struct s_cache_hdr {
+	char		magic[8];
+	uint64_t	dev;
+	uint64_t	ino;
+	uint64_t	size;
+	uint64_t	mtime_ns;
+	uint32_t	keyflags;
+	uint32_t	bits;
+	uint64_t	count;
+	uint64_t	strings_size;
+}	t_cache_hdr;
+
+typedef struct s_cache_rec {
+	uint64_t	addr;
+	uint32_t	name;
+	uint32_t	version;
+	uint16_t	shndx;
+	uint8_t		letter;
+	uint8_t		version_hidden;
+	uint32_t	pad;
+}	t_cache_rec;
+
+typedef struct s_cache_file {
+	char		*path;
+	uint64_t	mtime_ns;
+	off_t		size;
+}	t_cache_file;
+
+// bytes of indexes in the directory, as of the last scan plus later stores
+static size_t	g_cache_total = 0;
+static uint32_t	g_cache_stores = 0;
+
+/*
+** cache_keyflags
+**
+** Description:
+**   The flags that select or order the cached symbols, and the collation
+**   the order was computed under.
+*/
+static uint32_t cache_keyflags(t_nm_flags flags)
+{
+	return (flags.a ? 1 : 0) | (flags.p ? 2 : 0) | (flags.r ? 4 : 0)
+		| (flags.dynamic ? 8 : 0) | (flags.numeric ? 16 : 0) | (flags.p ? 0 : sort_collation() << 8);
+}
+
+static char *cache_hex(char *dst, uint64_t n)
+{
+	static const char digits[] = "0123456789abcdef";
+	int shift = 60;
+
+	while (shift > 0 && !(n >> shift))
+		shift -= 4;
+	for (; shift >= 0; shift -= 4)
+		*dst++ = digits[(n >> shift) & 0xf];
+	return dst;
+}
+
+/*
+** cache_path
+**
+** Description:
+**   Builds "DIR/<dev>-<ino>-<size>-<mtime_ns>-<flags>.nmidx" (hex fields).
+*/
+static char *cache_path(const char *dir, t_cache_hdr *key)
+{
+	size_t	len = ft_strlen(dir);
+	char	*path = malloc(len + 5 * 17 + sizeof(CACHE_EXT) + 1);
+	char	*p;
+
+	if (!path)
+		return NULL;
+	memcpy(path, dir, len);
+	p = path + len;
+	*p++ = '/';
+	p = cache_hex(p, key->dev);
+	*p++ = '-';
+	p = cache_hex(p, key->ino);
+	*p++ = '-';
+	p = cache_hex(p, key->size);
+	*p++ = '-';
+	p = cache_hex(p, key->mtime_ns);
+	*p++ = '-';
+	p = cache_hex(p, key->keyflags);
+	memcpy(p, CACHE_EXT, sizeof(CACHE_EXT));
+	return path;
+}
+
+/*
+** cache_open
+**
+** Description:
+**   Computes the key and index path of the file described by `st`. With
+**   no directory, the index is only built in memory (see cache_store).
+**   Returns -1 if the cache cannot be used for it.
+*/
+int cache_open(t_cache *c, const char *dir, struct stat *st, t_nm_flags flags)
+{
+	t_cache_hdr key;
+
+	memset(&key, 0, sizeof(key));
+	key.dev = st->st_dev;
+	key.ino = st->st_ino;
+	key.size = st->st_size;
+	key.mtime_ns = (uint64_t)st->st_mtim.tv_sec * 1000000000ULL + st->st_mtim.tv_nsec;
+	key.keyflags = cache_keyflags(flags);
+	c->dev = key.dev;
+	c->ino = key.ino;
+	c->size = key.size;
+	c->mtime_ns = key.mtime_ns;
+	c->keyflags = key.keyflags;
+	c->dir = dir;
+	c->max = flags.cache_max;
+	c->blob = NULL;
+	c->blob_size = 0;
+	c->path = NULL;
+	if (!dir)
+		return 0;
+	c->path = cache_path(dir, &key);
+	return c->path ? 0 : -1;
+}
+
+void cache_close(t_cache *c)
+{
+	free(c->path);
+	free(c->blob);
+	c->path = NULL;
+	c->blob = NULL;
+}
+
+/*
+** cache_valid
+**
+** Description:
+**   Checks a mapped index against the expected key and its own sizes, and
+**   that every string offset stays inside the string block, whose last
+**   byte must be a NUL.
+*/
+static bool cache_valid(t_cache *c, char *data, size_t size)
+{
+	t_cache_hdr *hdr = (t_cache_hdr *)data;
+	t_cache_rec *rec;
+	char *strings;
+
+	if (size < sizeof(t_cache_hdr) || memcmp(hdr->magic, CACHE_MAGIC, 8) != 0)
+		return false;
+	if (hdr->dev != c->dev || hdr->ino != c->ino || hdr->size != c->size
+		|| hdr->mtime_ns != c->mtime_ns || hdr->keyflags != c->keyflags
+		|| (hdr->bits != 32 && hdr->bits != 64))
+		return false;
+	if (hdr->count > (size - sizeof(t_cache_hdr)) / sizeof(t_cache_rec)
+		|| hdr->strings_size == 0
+		|| sizeof(t_cache_hdr) + hdr->count * sizeof(t_cache_rec) + hdr->strings_size != size)
+		return false;
+	rec = (t_cache_rec *)(data + sizeof(t_cache_hdr));
+	strings = (char *)(rec + hdr->count);
+	if (strings[hdr->strings_size - 1] != '\0')
+		return false;
+	for (uint64_t i = 0; i < hdr->count; i++)
+		if (rec[i].name >= hdr->strings_size
+			|| (rec[i].version != CACHE_NO_VERSION && rec[i].version >= hdr->strings_size))
+			return false;
+	return true;
+}
+
+/*
+** cache_print_index
+**
+** Description:
+**   Prints the listing held by a valid index through printTable, a chunk
+**   of records at a time. Returns -1 if the index does not match `c`.
+*/
+int cache_print_index(t_cache *c, char *data, size_t size, t_nm_flags flags)
+{
+	t_sym chunk[CACHE_CHUNK];
+
+	if (!cache_valid(c, data, size))
+		return -1;
+	t_cache_hdr *hdr = (t_cache_hdr *)data;
+	t_cache_rec *rec = (t_cache_rec *)(data + sizeof(t_cache_hdr));
+	char *strings = (char *)(rec + hdr->count);
+	for (uint64_t i = 0; i < hdr->count; i += CACHE_CHUNK)
+	{
+		size_t n = (hdr->count - i < CACHE_CHUNK) ? hdr->count - i : CACHE_CHUNK;
+		for (size_t k = 0; k < n; k++)
+		{
+			chunk[k].addr = rec[i + k].addr;
+			// -S and --size-sort never use an index (see ft_nm)
+			chunk[k].size = 0;
+			chunk[k].name = strings + rec[i + k].name;
+			chunk[k].letter = rec[i + k].letter;
+			chunk[k].shndx = rec[i + k].shndx;
+			chunk[k].version = (rec[i + k].version == CACHE_NO_VERSION) ? NULL : strings + rec[i + k].version;
+			chunk[k].version_hidden = rec[i + k].version_hidden;
+		}
+		printTable(chunk, n, flags, hdr->bits);
+	}
+	return 0;
+}
+
+/*
+** cache_print
+**
+** Description:
+**   Prints the listing from the index file of `c` and marks the index as
+**   recently used. Returns 0 on a hit and -1 when the file has to be
+**   parsed.
+*/
+int cache_print(t_cache *c, t_nm_flags flags)
+{
+	struct stat	st;
+	char		*data;
+	int			fd;
+	int			ret;
+
+	fd = open(c->path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) < 0 || st.st_size == 0)
+	{
+		close(fd);
+		return -1;
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close(fd);
+		return -1;
+	}
+	ret = cache_print_index(c, data, st.st_size, flags);
+	munmap(data, st.st_size);
+	// the modification time of an index is its last use, for eviction
+	if (ret == 0)
+		futimens(fd, NULL);
+	close(fd);
+	return ret;
+}
+
+/*
+** cache_file_cmp
+**
+** Description:
+**   qsort order for eviction: least recently used first.
+*/
+static int cache_file_cmp(const void *a, const void *b)
+{
+	const t_cache_file *x = a;
+	const t_cache_file *y = b;
+
+	return (x->mtime_ns > y->mtime_ns) - (x->mtime_ns < y->mtime_ns);
+}
+
+/*
+** cache_evict
+**
+** Description:
+**   Removes the least recently used indexes until those left fit in
+**   7/8 of `max` bytes, and the temporary files of runs killed more than
+**   CACHE_TMP_AGE seconds ago. Indexes another process removed first are
+**   skipped. Records the bytes left in g_cache_total.
+*/
+static void cache_evict(const char *dir, size_t max)
+{
+	DIR				*d;
+	struct dirent	*ent;
+	struct stat		st;
+	t_cache_file	*files = NULL;
+	size_t			count = 0;
+	size_t			cap = 0;
+	size_t			total = 0;
+	size_t			dlen = ft_strlen(dir);
+	size_t			len;
+	bool			tmp;
+	bool			found;
+
+	d = opendir(dir);
+	if (!d)
+		return;
+	while ((ent = readdir(d)))
+	{
+		len = ft_strlen(ent->d_name);
+		tmp = ent->d_name[0] == '.' && len > 5 && strcmp(ent->d_name + len - 4, ".tmp") == 0;
+		if (!tmp && (len <= sizeof(CACHE_EXT) - 1 || ent->d_name[0] == '.'
+			|| strcmp(ent->d_name + len - (sizeof(CACHE_EXT) - 1), CACHE_EXT) != 0))
+			continue;
+		if (count == cap)
+		{
+			cap = cap ? cap * 2 : 64;
+			t_cache_file *grown = realloc(files, sizeof(t_cache_file) * cap);
+			if (!grown)
+				break;
+			files = grown;
+		}
+		files[count].path = malloc(dlen + len + 2);
+		if (!files[count].path)
+			break;
+		memcpy(files[count].path, dir, dlen);
+		files[count].path[dlen] = '/';
+		memcpy(files[count].path + dlen + 1, ent->d_name, len + 1);
+		found = stat(files[count].path, &st) == 0;
+		// a temporary file this old belongs to a run that was killed
+		if (found && tmp && st.st_mtim.tv_sec + CACHE_TMP_AGE < time(NULL))
+			unlink(files[count].path);
+		if (!found || tmp)
+		{
+			free(files[count].path);
+			continue;
+		}
+		files[count].mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+		files[count].size = st.st_size;
+		total += st.st_size;
+		count++;
+	}
+	closedir(d);
+	qsort(files, count, sizeof(t_cache_file), cache_file_cmp);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (total > max - max / 8 && (unlink(files[i].path) == 0 || errno == ENOENT))
+			total -= files[i].size;
+		free(files[i].path);
+	}
+	free(files);
+	__atomic_store_n(&g_cache_total, total, __ATOMIC_RELAXED);
+}
+
+/*
+** cache_build
+**
+** Description:
+**   Serializes a sorted set, in print order, into a freshly allocated
+**   index of `*size` bytes. Returns NULL if it would exceed `c->max` or on
+**   allocation failure.
+*/
+static char *cache_build(t_cache *c, const t_symset *set, int bits, size_t *size)
+{
+	t_cache_hdr	hdr;
+	t_cache_rec	*rec;
+	t_sym		row;
+	char		*buf;
+	char		*strings;
+	size_t		tab_size = set->count;
+	size_t		strings_size = 1;
+	size_t		pos;
+
+	for (size_t i = 0; i < tab_size; i++)
+	{
+		symset_row(set, i, &row);
+		strings_size += strlen(row.name) + 1;
+		if (row.version)
+			strings_size += strlen(row.version) + 1;
+	}
+	if (strings_size > CACHE_NO_VERSION)
+		return NULL;
+	*size = sizeof(t_cache_hdr) + tab_size * sizeof(t_cache_rec) + strings_size;
+	if (*size > c->max)
+		return NULL;
+	buf = malloc(*size);
+	if (!buf)
+		return NULL;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CACHE_MAGIC, 8);
+	hdr.dev = c->dev;
+	hdr.ino = c->ino;
+	hdr.size = c->size;
+	hdr.mtime_ns = c->mtime_ns;
+	hdr.keyflags = c->keyflags;
+	hdr.bits = bits;
+	hdr.count = tab_size;
+	hdr.strings_size = strings_size;
+	memcpy(buf, &hdr, sizeof(hdr));
+	rec = (t_cache_rec *)(buf + sizeof(hdr));
+	strings = (char *)(rec + tab_size);
+	strings[0] = '\0';
+	pos = 1;
+	for (size_t i = 0; i < tab_size; i++)
+	{
+		symset_row(set, symset_at(set, i), &row);
+		size_t len = strlen(row.name) + 1;
+
+		rec[i].addr = row.addr;
+		rec[i].shndx = row.shndx;
+		rec[i].letter = row.letter;
+		rec[i].version_hidden = row.version_hidden;
+		rec[i].pad = 0;
+		rec[i].name = pos;
+		memcpy(strings + pos, row.name, len);
+		pos += len;
+		rec[i].version = CACHE_NO_VERSION;
+		if (row.version)
+		{
+			len = strlen(row.version) + 1;
+			rec[i].version = pos;
+			memcpy(strings + pos, row.version, len);
+			pos += len;
+		}
+	}
+	return buf;
+}
+
+/*
+** cache_store
+**
+** Description:
+**   Records the sorted list of a file. Without a directory (--serve) the
+**   index is kept in `c->blob` for the caller. Otherwise the whole index
+**   is written to a temporary file in DIR, which is then renamed over the
+**   final name. Failures are silent, the cache is only an optimization.
+*/
+void cache_store(t_cache *c, const t_symset *set, int bits)
+{
+	static uint32_t	seq = 0;
+	char			*buf;
+	size_t			size;
+	char			*tmp;
+	char			*p;
+	int				fd;
+
+	buf = cache_build(c, set, bits, &size);
+	if (!buf)
+		return;
+	if (!c->dir)
+	{
+		free(c->blob);
+		c->blob = buf;
+		c->blob_size = size;
+		return;
+	}
+	tmp = malloc(ft_strlen(c->dir) + 3 * 17 + 8);
+	if (!tmp)
+	{
+		free(buf);
+		return;
+	}
+
+	// "DIR/.<pid>-<sequence>.tmp": unique per process and per call
+	p = tmp + ft_strlen(c->dir);
+	memcpy(tmp, c->dir, p - tmp);
+	*p++ = '/';
+	*p++ = '.';
+	p = cache_hex(p, getpid());
+	*p++ = '-';
+	p = cache_hex(p, __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED));
+	memcpy(p, ".tmp", 5);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (fd >= 0)
+	{
+		bool ok = true;
+		for (size_t done = 0; ok && done < size; )
+		{
+			ssize_t ret = write(fd, buf + done, size - done);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			ok = ret > 0;
+			done += ok ? ret : 0;
+		}
+		close(fd);
+		if (!ok || rename(tmp, c->path) < 0)
+			unlink(tmp);
+		else if (__atomic_fetch_add(&g_cache_stores, 1, __ATOMIC_RELAXED) % CACHE_SCAN_EVERY == 0
+			|| __atomic_add_fetch(&g_cache_total, size, __ATOMIC_RELAXED) > c->max)
+			cache_evict(c->dir, c->max);
+	}
+	free(tmp);
+	free(buf);
+}
@@ -0,0 +1,183 @@
+#include "nm.h"
+
+/*
+** C++ demangling (-C, --demangle)
+**
+** Description:
+**   Names of the Itanium C++ ABI (those starting with _Z) are printed
+**   demangled, as binutils does with its default style; anything else is
+**   printed as it is. The decoding itself is the C++ runtime's
+**   __cxa_demangle. Symbols are still sorted by their mangled names, like
+**   binutils, and only the lines that are printed get demangled.
+**
+**   Results are memoized for the whole run in a table keyed by the
+**   mangled name, so a name seen in several files or archive members is
+**   decoded once. The table is cut into DEMANGLE_SHARDS shards, each with
+**   its own lock, t_strmap and t_strpool (strmap.c), so that -j workers and the
+**   parts of a split listing rarely wait for each other; the decoding
+**   runs outside any lock.
+**
+** Why:
+**   Piping the listing of a C++ binary to c++filt doubles the wall time
+**   and waits for the whole listing. Template instantiations repeat the
+**   same names across objects, and their decoding costs far more than a
+**   hash lookup.
+*/
+
+// from the C++ runtime (cxxabi.h), which this C program links against
+char *__cxa_demangle(const char *mangled_name, char *output_buffer, size_t *length, int *status);
+
+/*
+** demangle_init
+**
+** Description:
+**   Prepares an empty memo table.
+*/
+void demangle_init(t_demangle *d)
+{
+	memset(d, 0, sizeof(*d));
+	for (int i = 0; i < DEMANGLE_SHARDS; i++)
+	{
+		strmap_init(&d->shards[i].map, sizeof(t_demangle_entry),
+			offsetof(t_demangle_entry, hash), offsetof(t_demangle_entry, mangled));
+		pthread_mutex_init(&d->shards[i].lock, NULL);
+	}
+}
+
+/*
+** demangle_insert
+**
+** Description:
+**   Records `name` and its decoding (NULL when it is not a valid mangled
+**   name) in a shard, the lock being held, unless another thread did in
+**   the meantime. Returns what the table now holds for the name, or NULL
+**   if memory is exhausted.
+*/
+static t_demangle_entry *demangle_insert(t_demangle_shard *sh, const char *name, uint32_t hash,
+	const char *plain)
+{
+	t_demangle_entry	*e;
+	size_t				s;
+
+	if (strmap_reserve(&sh->map, sh->entries, sh->count) < 0)
+		return NULL;
+	s = strmap_find(&sh->map, sh->entries, name, hash);
+	if (sh->map.slots[s])
+		return &sh->entries[sh->map.slots[s] - 1];
+	if (sh->count == sh->cap)
+	{
+		size_t				cap = sh->cap ? sh->cap * 2 : 1024;
+		t_demangle_entry	*grown = realloc(sh->entries, sizeof(t_demangle_entry) * cap);
+
+		if (!grown)
+			return NULL;
+		sh->entries = grown;
+		sh->cap = cap;
+	}
+	e = &sh->entries[sh->count];
+	e->hash = hash;
+	if (!(e->mangled = strpool_dup(&sh->pool, name, ft_strlen(name))))
+		return NULL;
+	e->plain = NULL;
+	if (plain && !(e->plain = strpool_dup(&sh->pool, plain, ft_strlen(plain))))
+		return NULL;
+	sh->map.slots[s] = ++sh->count;
+	return e;
+}
+
+/*
+** demangle_decode
+**
+** Description:
+**   Decodes a mangled name into a malloc'ed string, or returns NULL. A
+**   version suffix glued to the name (`_Z3foov@GLIBC_2.2.5` in the .symtab
+**   of a linked program) is set aside and put back, like binutils does.
+*/
+static char *demangle_decode(const char *name)
+{
+	const char	*at = strchr(name, '@');
+	char		*base;
+	char		*plain;
+	char		*full;
+	size_t		len;
+	int			status;
+
+	if (!at)
+	{
+		plain = __cxa_demangle(name, NULL, NULL, &status);
+		return status == 0 ? plain : NULL;
+	}
+	if (!(base = malloc(at - name + 1)))
+		return NULL;
+	memcpy(base, name, at - name);
+	base[at - name] = '\0';
+	plain = __cxa_demangle(base, NULL, NULL, &status);
+	free(base);
+	if (status != 0)
+		return NULL;
+	len = ft_strlen(plain);
+	if ((full = malloc(len + ft_strlen(at) + 1)))
+	{
+		memcpy(full, plain, len);
+		memcpy(full + len, at, ft_strlen(at) + 1);
+	}
+	free(plain);
+	return full;
+}
+
+/*
+** demangle_name
+**
+** Description:
+**   The demangled form of `name`, or `name` itself when it is not a
+**   mangled C++ name or memory ran out. The result stays valid until
+**   demangle_free. Safe to call from several threads.
+*/
+const char *demangle_name(t_demangle *d, const char *name)
+{
+	uint32_t			hash;
+	t_demangle_shard	*sh;
+	t_demangle_entry	*e;
+	const char			*found = NULL;
+	char				*plain;
+	size_t				s;
+
+	if (name[0] != '_' || name[1] != 'Z')
+		return name;
+	hash = gnu_hash(name);
+	// the top bits pick the shard, the low ones the slot
+	sh = &d->shards[hash >> (32 - DEMANGLE_SHARD_BITS)];
+	// entries move when the shard grows: only pool strings outlive the lock
+	pthread_mutex_lock(&sh->lock);
+	if (sh->map.nslots && sh->map.slots[s = strmap_find(&sh->map, sh->entries, name, hash)])
+	{
+		e = &sh->entries[sh->map.slots[s] - 1];
+		found = e->plain ? e->plain : name;
+	}
+	pthread_mutex_unlock(&sh->lock);
+	if (found)
+		return found;
+	plain = demangle_decode(name);
+	pthread_mutex_lock(&sh->lock);
+	// not memoized when memory is exhausted: the name is printed mangled
+	found = name;
+	if ((e = demangle_insert(sh, name, hash, plain)) && e->plain)
+		found = e->plain;
+	pthread_mutex_unlock(&sh->lock);
+	free(plain);
+	return found;
+}
+
+void demangle_free(t_demangle *d)
+{
+	t_demangle_shard	*sh;
+
+	for (int i = 0; i < DEMANGLE_SHARDS; i++)
+	{
+		sh = &d->shards[i];
+		strpool_free(&sh->pool);
+		strmap_free(&sh->map);
+		free(sh->entries);
+		pthread_mutex_destroy(&sh->lock);
+	}
+}
@@ -0,0 +1,344 @@
+#include "nm.h"
+
+/*
+** Symbol table diff (--diff OLD NEW)
+**
+** Description:
+**   Compares the listed symbols of two ELF objects (-D: their dynamic
+**   symbols; -g, -u and the address range filter both sides) and prints,
+**   in name order, one line per difference:
+**     + NAME LETTER SIZE   only in NEW
+**     - NAME LETTER SIZE   only in OLD
+**     L NAME OLD NEW       the letter changed
+**     S NAME OLD NEW       the size changed (decimal bytes)
+**   A symbol is keyed by its name and version suffix, so foo@@V1 turning
+**   into foo@@V2 is a removal and an addition. Symbols sharing a key (the
+**   locals of several translation units) are paired in listing order.
+**   Identical tables print nothing. The exit status is that of diff(1):
+**   0 for identical tables, 1 when differences were printed, 2 on
+**   trouble.
+**
+**   Each table comes out of the usual handle64/handle32 path and is
+**   sorted by name like a listing. OLD's shown symbols are then copied
+**   out of its mapping and arena, and NEW's table is merged against them
+**   in place, before its file is released.
+**
+** Why:
+**   Two listings piped to diff(1) compare addresses too, so every symbol
+**   after an inserted function shows up as changed, and diff's LCS costs
+**   far more than a merge of two sorted tables. Here memory stays at the
+**   two tables.
+*/
+
+/*
+** diff_collect
+**
+** Description:
+**   The shown symbols of a sorted set, in order, in the arena. Returns
+**   NULL if memory ran out.
+*/
+static t_diff_sym *diff_collect(const t_symset *set, t_nm_flags flags, size_t *count)
+{
+	t_diff_sym	*syms = arena_alloc(sizeof(t_diff_sym) * (set->count + 1));
+	size_t		n = 0;
+	size_t		i;
+	uint16_t	code;
+
+	if (!syms)
+		return NULL;
+	for (size_t k = 0; k < set->count; k++)
+	{
+		i = symset_at(set, k);
+		if (!sym_shown(set->letter[i], set->shndx[i], set->addr[i], set->size[i], flags))
+			continue;
+		code = set->version ? set->version[i] : 0;
+		syms[n].name = symset_name(set, i);
+		syms[n].version = code ? version_name(set->vernames, set->nvernames, code) : NULL;
+		syms[n].size = set->size[i];
+		syms[n].letter = set->letter[i];
+		syms[n].hidden = (code & VERSION_HIDDEN) != 0;
+		syms[n].undef = set->shndx[i] == SHN_UNDEF;
+		n++;
+	}
+	*count = n;
+	return syms;
+}
+
+/*
+** diff_keep
+**
+** Description:
+**   Copies OLD's symbols and their strings into two allocations that
+**   outlive its file. Returns -1 if memory ran out.
+*/
+static int diff_keep(t_diff *d, const t_diff_sym *syms, size_t count)
+{
+	size_t	total = 1;
+	char	*p;
+
+	for (size_t k = 0; k < count; k++)
+		total += ft_strlen(syms[k].name) + 1 + (syms[k].version ? ft_strlen(syms[k].version) + 1 : 0);
+	d->old = malloc(sizeof(t_diff_sym) * (count + 1));
+	d->strings = malloc(total);
+	if (!d->old || !d->strings)
+		return -1;
+	p = d->strings;
+	for (size_t k = 0; k < count; k++)
+	{
+		d->old[k] = syms[k];
+		d->old[k].name = p;
+		p += ft_strlen(syms[k].name) + 1;
+		memcpy((char *)d->old[k].name, syms[k].name, p - d->old[k].name);
+		if (syms[k].version)
+		{
+			d->old[k].version = p;
+			p += ft_strlen(syms[k].version) + 1;
+			memcpy((char *)d->old[k].version, syms[k].version, p - d->old[k].version);
+		}
+	}
+	d->nold = count;
+	d->loaded = true;
+	return 0;
+}
+
+/*
+** diff_cmp
+**
+** Description:
+**   The name order sort() gives a listing: the locale's collation, then
+**   the bytes.
+*/
+static int diff_cmp(const char *a, const char *b, bool collate)
+{
+	int ret;
+
+	if (collate && (ret = strcoll(a, b)) != 0)
+		return ret;
+	return strcmp(a, b);
+}
+
+static bool diff_same_key(const t_diff_sym *a, const t_diff_sym *b)
+{
+	if (!a->version || !b->version)
+		return a->version == b->version;
+	return a->hidden == b->hidden && strcmp(a->version, b->version) == 0;
+}
+
+static void diff_name(t_out *out, char kind, const t_diff_sym *s, t_nm_flags flags)
+{
+	out_putc(out, kind);
+	out_putc(out, ' ');
+	out_str(out, flags.demangle ? demangle_name(flags.demangle_table, s->name) : s->name);
+	if (s->version)
+	{
+		out_str(out, (s->hidden || s->undef) ? "@" : "@@");
+		out_str(out, s->version);
+	}
+}
+
+static void diff_size(t_out *out, uint64_t size)
+{
+	char	tmp[20];
+	int		i = 20;
+
+	out_putc(out, ' ');
+	do
+		tmp[--i] = '0' + size % 10;
+	while (size /= 10);
+	out_write(out, tmp + i, 20 - i);
+}
+
+// a + or - line
+static size_t diff_one(t_out *out, char kind, const t_diff_sym *s, t_nm_flags flags)
+{
+	diff_name(out, kind, s, flags);
+	out_putc(out, ' ');
+	out_putc(out, s->letter);
+	diff_size(out, s->size);
+	out_putc(out, '\n');
+	return 1;
+}
+
+// the L and S lines of a symbol found on both sides
+static size_t diff_change(t_out *out, const t_diff_sym *a, const t_diff_sym *b, t_nm_flags flags)
+{
+	size_t lines = 0;
+
+	if (a->letter != b->letter)
+	{
+		diff_name(out, 'L', b, flags);
+		out_putc(out, ' ');
+		out_putc(out, a->letter);
+		out_putc(out, ' ');
+		out_putc(out, b->letter);
+		out_putc(out, '\n');
+		lines++;
+	}
+	if (a->size != b->size)
+	{
+		diff_name(out, 'S', b, flags);
+		diff_size(out, a->size);
+		diff_size(out, b->size);
+		out_putc(out, '\n');
+		lines++;
+	}
+	return lines;
+}
+
+/*
+** diff_group
+**
+** Description:
+**   Pairs the `na` OLD and `nb` NEW symbols sharing a name: each OLD one
+**   takes the first free NEW one with the same version suffix. The scan
+**   starts at the first free one, so a group without versions pairs in
+**   linear time.
+*/
+static size_t diff_group(const t_diff_sym *a, size_t na, const t_diff_sym *b, size_t nb,
+	bool *used, t_nm_flags flags)
+{
+	t_out	*out = out_stdout();
+	size_t	lines = 0;
+	size_t	first = 0;
+	size_t	m;
+
+	for (size_t k = 0; k < na; k++)
+	{
+		m = first;
+		while (m < nb && (used[m] || !diff_same_key(&a[k], &b[m])))
+			m++;
+		if (m == nb)
+		{
+			lines += diff_one(out, '-', &a[k], flags);
+			continue;
+		}
+		used[m] = true;
+		lines += diff_change(out, &a[k], &b[m], flags);
+		while (first < nb && used[first])
+			first++;
+	}
+	for (m = first; m < nb; m++)
+		if (!used[m])
+			lines += diff_one(out, '+', &b[m], flags);
+	return lines;
+}
+
+static size_t diff_group_end(const t_diff_sym *s, size_t i, size_t count)
+{
+	size_t j = i + 1;
+
+	while (j < count && strcmp(s[j].name, s[i].name) == 0)
+		j++;
+	return j;
+}
+
+/*
+** diff_report
+**
+** Description:
+**   Merges NEW's `count` sorted symbols with OLD's and prints the report.
+**   Returns -1 if memory ran out.
+*/
+static int diff_report(t_diff *d, const t_diff_sym *syms, size_t count, t_nm_flags flags)
+{
+	t_out	*out = out_stdout();
+	bool	collate = sort_collation() != 0;
+	bool	*used = arena_alloc(count + 1);
+	size_t	lines = 0;
+	size_t	i = 0;
+	size_t	j = 0;
+	size_t	i2;
+	size_t	j2;
+	int		cmp;
+
+	if (!used)
+		return -1;
+	memset(used, 0, count + 1);
+	d->reported = true;
+	while (i < d->nold || j < count)
+	{
+		cmp = i == d->nold ? 1 : j == count ? -1 : diff_cmp(d->old[i].name, syms[j].name, collate);
+		if (cmp < 0)
+			lines += diff_one(out, '-', &d->old[i++], flags);
+		else if (cmp > 0)
+			lines += diff_one(out, '+', &syms[j++], flags);
+		else
+		{
+			i2 = diff_group_end(d->old, i, d->nold);
+			j2 = diff_group_end(syms, j, count);
+			lines += diff_group(d->old + i, i2 - i, syms + j, j2 - j, used + j, flags);
+			i = i2;
+			j = j2;
+		}
+	}
+	stats_add(STATS_PRINTED, lines);
+	d->changed = lines != 0;
+	return 0;
+}
+
+/*
+** diff_add
+**
+** Description:
+**   Takes the classified table of one side, OLD first, then NEW. Returns
+**   -1 if memory ran out.
+*/
+int diff_add(t_diff *d, t_symset *set, t_nm_flags flags)
+{
+	t_nm_flags	order = flags;
+	t_diff_sym	*syms;
+	size_t		count;
+	int			ret;
+
+	// the report is in name order, whatever the listing order flags
+	order.p = 0;
+	order.numeric = 0;
+	order.size_sort = 0;
+	order.r = 0;
+	if (sort(set, order) < 0 || !(syms = diff_collect(set, flags, &count)))
+		return -1;
+	stats_phase(STATS_SORT);
+	ret = d->loaded ? diff_report(d, syms, count, flags) : diff_keep(d, syms, count);
+	stats_phase(STATS_PRINT);
+	return ret;
+}
+
+/*
+** diff_main
+**
+** Description:
+**   Runs --diff on the `count` file names left on the command line, which
+**   must be OLD and NEW. An object without a symbol table (stripped, or
+**   without a dynamic one under -D) compares as an empty table. Returns
+**   the exit status: 0 when the tables are identical, 1 when they differ,
+**   2 on failure, after printing why.
+*/
+int diff_main(char **files, int count, t_nm_flags flags)
+{
+	t_diff	d;
+	int		ret;
+
+	if (count != 2 || flags.xref || flags.resolve || flags.nlookup || flags.format != FORMAT_BSD)
+	{
+		ft_putstr_fd(2, "ft_nm: '--diff' takes two files, OLD and NEW, and no '--xref',"
+			" '--resolve', '--lookup' or '--format'\n");
+		return 2;
+	}
+	memset(&d, 0, sizeof(d));
+	flags.diff_table = &d;
+	ret = nm_file(files[0], flags, 0);
+	d.loaded = true;
+	if (ret == 0)
+		ret = nm_file(files[1], flags, 0);
+	if (ret == 0 && !d.reported && diff_report(&d, NULL, 0, flags) < 0)
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		ret = 1;
+	}
+	arena_reset();
+	free(d.old);
+	free(d.strings);
+	if (ret != 0)
+		return 2;
+	return d.changed;
+}
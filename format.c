@@ -0,0 +1,460 @@
+#include "nm.h"
+
+/*
+** Output formats (-P, --format=bsd|posix|json|csv)
+**
+** Description:
+**   The default listing is the BSD one (see print_line). The others print
+**   one symbol per line as well:
+**     posix  NAME LETTER VALUE SIZE, like `nm -P`: hexadecimal without
+**            padding, no size when it is 0, blanks for undefined symbols;
+**            `file:` or `archive[member]:` headers instead of the BSD ones
+**     json   one object per line with the keys of the csv columns, the
+**            value as a "0x..." string and the size as a number; member
+**            and version are null when there is none
+**     csv    a header line, then file,member,name,version,letter,value,
+**            size,section,bind,type; fields holding a comma, a quote or
+**            a line break are quoted (RFC 4180)
+**   The version is the suffix nm prints, separator included (@ or @@).
+**   The section is the name of the symbol's section, or *UND*, *ABS* or
+**   *COM*; bind and type are the ELF names of st_info's halves (GLOBAL,
+**   FUNC...), or their number when they have none. json and csv carry the
+**   file and member names on every line and print no headers.
+**
+** Why:
+**   Pipelines that parse the BSD listing back with awk spend as much time
+**   splitting it as ft_nm took to print it. A json or csv line is built
+**   whole in a stack buffer, strings being escaped through two 256-entry
+**   tables at one load per byte, and reaches the 64 KiB output buffer
+**   with a single copy instead of a call per field.
+*/
+
+/*
+** g_json_escape
+**
+** Description:
+**   For each byte, 0 when it goes into a JSON string as it is, else the
+**   letter of its escape: \" \\ \b \t \n \f \r, or 'u' for \u00XX.
+**   Bytes from 0x80 are marked '8': they are copied when they start a
+**   valid UTF-8 sequence (see json_utf8), else escaped as \u00XX.
+*/
+static const char g_json_escape[256] = {
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	['"'] = '"', ['\\'] = '\\',
+	[0x80 ... 0xff] = '8'
+};
+
+// bytes that make a CSV field quoted
+static const bool g_csv_special[256] = {
+	[','] = true, ['"'] = true, ['\n'] = true, ['\r'] = true
+};
+
+static const char *g_bind_names[16] = {
+	"LOCAL", "GLOBAL", "WEAK", "3", "4", "5", "6", "7",
+	"8", "9", "UNIQUE", "11", "12", "13", "14", "15"
+};
+
+static const char *g_type_names[16] = {
+	"NOTYPE", "OBJECT", "FUNC", "SECTION", "FILE", "COMMON", "TLS", "7",
+	"8", "9", "IFUNC", "11", "12", "13", "14", "15"
+};
+
+static const char g_hex_digits[] = "0123456789abcdef";
+
+/*
+** format_parse
+**
+** Description:
+**   Parses the value of --format. Returns -1 for an unknown format.
+*/
+int format_parse(const char *value)
+{
+	if (!value)
+		return -1;
+	if (strcmp(value, "bsd") == 0)
+		return FORMAT_BSD;
+	if (strcmp(value, "posix") == 0)
+		return FORMAT_POSIX;
+	if (strcmp(value, "json") == 0)
+		return FORMAT_JSON;
+	if (strcmp(value, "csv") == 0)
+		return FORMAT_CSV;
+	return -1;
+}
+
+/*
+** format_begin
+**
+** Description:
+**   Prints what comes before the first listing: the csv header line.
+*/
+void format_begin(t_nm_flags flags)
+{
+	if (flags.format == FORMAT_CSV && !flags.xref && !flags.resolve)
+		out_str(out_stdout(), "file,member,name,version,letter,value,size,section,bind,type\n");
+}
+
+/*
+** format_header
+**
+** Description:
+**   -P: the `file:` header of an object when several files are listed, or
+**   the `archive[member]:` one of an archive member.
+*/
+void format_header(t_nm_flags flags)
+{
+	t_out *out = out_stdout();
+
+	if (flags.format != FORMAT_POSIX || (!flags.member_name && !flags.print_fname))
+		return;
+	out_str(out, flags.file_name);
+	if (flags.member_name)
+	{
+		out_putc(out, '[');
+		out_str(out, flags.member_name);
+		out_putc(out, ']');
+	}
+	out_str(out, ":\n");
+}
+
+// writes `n` in hexadecimal without padding at `dst`, returns the length
+static int put_hex(char *dst, uint64_t n)
+{
+	int digits = 1;
+
+	while (digits < 16 && (n >> (digits * 4)))
+		digits++;
+	for (int i = digits - 1; i >= 0; i--)
+	{
+		dst[i] = g_hex_digits[n & 15];
+		n >>= 4;
+	}
+	return digits;
+}
+
+// writes `n` in decimal at `dst`, returns the length
+static int put_dec(char *dst, uint64_t n)
+{
+	char	tmp[20];
+	int		i = 20;
+
+	do
+		tmp[--i] = '0' + n % 10;
+	while (n /= 10);
+	memcpy(dst, tmp + i, 20 - i);
+	return 20 - i;
+}
+
+// the separator nm prints before a version: hidden or undefined @, else @@
+static const char *version_sep(const t_sym *row)
+{
+	return (row->version_hidden || row->shndx == SHN_UNDEF) ? "@" : "@@";
+}
+
+/*
+** posix_line
+**
+** Description:
+**   One -P line: NAME LETTER VALUE SIZE, the size left out when it is 0,
+**   and the value and size blanked for undefined symbols, like binutils.
+*/
+static void posix_line(t_out *out, const t_sym *row)
+{
+	char	tmp[48];
+	int		n = 0;
+
+	out_str(out, row->name);
+	if (row->version)
+	{
+		out_str(out, version_sep(row));
+		out_str(out, row->version);
+	}
+	tmp[n++] = ' ';
+	tmp[n++] = row->letter;
+	if (row->shndx == SHN_UNDEF)
+	{
+		memcpy(tmp + n, "         \n", 10);
+		out_write(out, tmp, n + 10);
+		return;
+	}
+	tmp[n++] = ' ';
+	n += put_hex(tmp + n, row->addr);
+	tmp[n++] = ' ';
+	if (row->size)
+		n += put_hex(tmp + n, row->size);
+	tmp[n++] = '\n';
+	out_write(out, tmp, n);
+}
+
+/*
+** json_utf8
+**
+** Description:
+**   The length of the valid UTF-8 sequence starting at `s` (at most
+**   `len` bytes), or 0 when it is not one: a stray continuation byte, a
+**   truncated or overlong sequence, a surrogate or a code point past
+**   U+10FFFF.
+*/
+static size_t json_utf8(const unsigned char *s, size_t len)
+{
+	size_t			n;
+	unsigned char	lo = 0x80;
+	unsigned char	hi = 0xbf;
+
+	if (s[0] >= 0xc2 && s[0] <= 0xdf)
+		n = 2;
+	else if (s[0] >= 0xe0 && s[0] <= 0xef)
+		n = 3;
+	else if (s[0] >= 0xf0 && s[0] <= 0xf4)
+		n = 4;
+	else
+		return 0;
+	if (s[0] == 0xe0)
+		lo = 0xa0;
+	else if (s[0] == 0xed)
+		hi = 0x9f;
+	else if (s[0] == 0xf0)
+		lo = 0x90;
+	else if (s[0] == 0xf4)
+		hi = 0x8f;
+	if (n > len || s[1] < lo || s[1] > hi)
+		return 0;
+	for (size_t i = 2; i < n; i++)
+		if (s[i] < 0x80 || s[i] > 0xbf)
+			return 0;
+	return n;
+}
+
+/*
+** json_copy
+**
+** Description:
+**   Writes `prefix` followed by the `len` bytes of `s` at `dst` as one
+**   JSON string; the prefix needs no escape. Symbol names are bytes, not
+**   text: valid UTF-8 is copied, and any other byte from 0x80 is written
+**   as \u00XX, the code point of the same number, so that the output is
+**   always valid JSON. Returns the end of what was written, at most
+**   6 * len + prefix + 2 bytes.
+*/
+static char *json_copy(char *dst, const char *prefix, const char *s, size_t len)
+{
+	char	e;
+	size_t	n;
+
+	*dst++ = '"';
+	while (*prefix)
+		*dst++ = *prefix++;
+	for (size_t i = 0; i < len; i++)
+	{
+		if (!(e = g_json_escape[(unsigned char)s[i]]))
+		{
+			*dst++ = s[i];
+			continue;
+		}
+		if (e == '8' && (n = json_utf8((const unsigned char *)s + i, len - i)))
+		{
+			memcpy(dst, s + i, n);
+			dst += n;
+			i += n - 1;
+			continue;
+		}
+		if (e == '8')
+			e = 'u';
+		*dst++ = '\\';
+		*dst++ = e;
+		if (e == 'u')
+		{
+			memcpy(dst, "00", 2);
+			dst[2] = g_hex_digits[(unsigned char)s[i] >> 4];
+			dst[3] = g_hex_digits[(unsigned char)s[i] & 15];
+			dst += 4;
+		}
+	}
+	*dst++ = '"';
+	return dst;
+}
+
+/*
+** csv_copy
+**
+** Description:
+**   Writes `prefix` followed by the `len` bytes of `s` at `dst` as one CSV
+**   field: as they are, or quoted with the quotes of `s` doubled when it
+**   holds a byte of g_csv_special. The prefix needs no quoting. Returns
+**   the end of what was written, at most 2 * len + prefix + 2 bytes.
+*/
+static char *csv_copy(char *dst, const char *prefix, const char *s, size_t len)
+{
+	char	*p = dst;
+	bool	special = false;
+
+	while (*prefix)
+		*p++ = *prefix++;
+	for (size_t i = 0; i < len; i++)
+	{
+		special |= g_csv_special[(unsigned char)s[i]];
+		*p++ = s[i];
+	}
+	if (!special)
+		return p;
+	// rare: write it again, quoted
+	memmove(dst + 1, dst, p - dst - len);
+	*dst = '"';
+	p = dst + 1 + (p - dst - len);
+	for (size_t i = 0; i < len; i++)
+	{
+		if (s[i] == '"')
+			*p++ = '"';
+		*p++ = s[i];
+	}
+	*p++ = '"';
+	return p;
+}
+
+// appends a string literal at `p`, returns its end
+#define PUT_LIT(p, lit) (memcpy(p, lit, sizeof(lit) - 1), (p) + sizeof(lit) - 1)
+
+static char *put_lit(char *dst, const char *lit)
+{
+	size_t len = ft_strlen(lit);
+
+	memcpy(dst, lit, len);
+	return dst + len;
+}
+
+/*
+** t_fields
+**
+** Description:
+**   The strings of a json or csv line and their lengths.
+*/
+typedef struct s_fields {
+	const char	*str[5];
+	size_t		len[5];
+	size_t		total;
+}	t_fields;
+
+enum e_field { F_FILE, F_MEMBER, F_NAME, F_VERSION, F_SECTION };
+
+static void fields_init(t_fields *f, const t_sym *row, t_nm_flags flags)
+{
+	f->str[F_FILE] = flags.file_name ? flags.file_name : "";
+	f->str[F_MEMBER] = flags.member_name ? flags.member_name : "";
+	f->str[F_NAME] = row->name;
+	f->str[F_VERSION] = row->version ? row->version : "";
+	f->str[F_SECTION] = row->section ? row->section : "";
+	f->total = 0;
+	for (int i = 0; i < 5; i++)
+	{
+		f->len[i] = ft_strlen(f->str[i]);
+		f->total += f->len[i];
+	}
+}
+
+/*
+** json_line
+**
+** Description:
+**   One JSON object, keys in the order of the csv columns, built in `buf`.
+**   Returns its length.
+*/
+static size_t json_line(char *buf, const t_sym *row, t_nm_flags flags, const t_fields *f)
+{
+	char *p = buf;
+
+	p = PUT_LIT(p, "{\"file\":");
+	p = json_copy(p, "", f->str[F_FILE], f->len[F_FILE]);
+	p = PUT_LIT(p, ",\"member\":");
+	p = flags.member_name ? json_copy(p, "", f->str[F_MEMBER], f->len[F_MEMBER]) : PUT_LIT(p, "null");
+	p = PUT_LIT(p, ",\"name\":");
+	p = json_copy(p, "", f->str[F_NAME], f->len[F_NAME]);
+	p = PUT_LIT(p, ",\"version\":");
+	p = row->version ? json_copy(p, version_sep(row), f->str[F_VERSION], f->len[F_VERSION])
+		: PUT_LIT(p, "null");
+	p = PUT_LIT(p, ",\"letter\":\"");
+	*p++ = row->letter;
+	p = PUT_LIT(p, "\",\"value\":\"0x");
+	p += put_hex(p, row->addr);
+	p = PUT_LIT(p, "\",\"size\":");
+	p += put_dec(p, row->size);
+	p = PUT_LIT(p, ",\"section\":");
+	p = json_copy(p, "", f->str[F_SECTION], f->len[F_SECTION]);
+	p = PUT_LIT(p, ",\"bind\":\"");
+	p = put_lit(p, g_bind_names[row->info >> 4]);
+	p = PUT_LIT(p, "\",\"type\":\"");
+	p = put_lit(p, g_type_names[row->info & 15]);
+	p = PUT_LIT(p, "\"}\n");
+	return p - buf;
+}
+
+/*
+** csv_line
+**
+** Description:
+**   One csv record, in the order of the header of format_begin, built in
+**   `buf`. Returns its length.
+*/
+static size_t csv_line(char *buf, const t_sym *row, const t_fields *f)
+{
+	char *p = buf;
+
+	p = csv_copy(p, "", f->str[F_FILE], f->len[F_FILE]);
+	*p++ = ',';
+	p = csv_copy(p, "", f->str[F_MEMBER], f->len[F_MEMBER]);
+	*p++ = ',';
+	p = csv_copy(p, "", f->str[F_NAME], f->len[F_NAME]);
+	*p++ = ',';
+	if (row->version)
+		p = csv_copy(p, version_sep(row), f->str[F_VERSION], f->len[F_VERSION]);
+	*p++ = ',';
+	*p++ = row->letter;
+	p = PUT_LIT(p, ",0x");
+	p += put_hex(p, row->addr);
+	*p++ = ',';
+	p += put_dec(p, row->size);
+	*p++ = ',';
+	p = csv_copy(p, "", f->str[F_SECTION], f->len[F_SECTION]);
+	*p++ = ',';
+	p = put_lit(p, g_bind_names[row->info >> 4]);
+	*p++ = ',';
+	p = put_lit(p, g_type_names[row->info & 15]);
+	*p++ = '\n';
+	return p - buf;
+}
+
+/*
+** format_line
+**
+** Description:
+**   Prints one symbol in any format but the BSD one. A json or csv line
+**   is built whole, on the stack unless its names are very long, and
+**   handed to the output layer with a single out_write.
+*/
+void format_line(t_out *out, const t_sym *row, t_nm_flags flags)
+{
+	char		stack[1024];
+	char		*buf = stack;
+	t_fields	f;
+	size_t		need;
+
+	if (flags.format == FORMAT_POSIX)
+	{
+		posix_line(out, row);
+		return;
+	}
+	fields_init(&f, row, flags);
+	// every byte of a string may take 6 (\u00XX), the rest is bounded
+	need = f.total * 6 + 256;
+	if (need > sizeof(stack) && !(buf = malloc(need)))
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return;
+	}
+	if (flags.format == FORMAT_JSON)
+		out_write(out, buf, json_line(buf, row, flags, &f));
+	else
+		out_write(out, buf, csv_line(buf, row, &f));
+	if (buf != stack)
+		free(buf);
+}
@@ -1,27 +1,38 @@
-#include "nm.h"
-
-void	print_hex(uint64_t nbr, int width)
-{
-	char	*base = "0123456789abcdef";
-	char	buffer[17]; 
-	int		i;
-
-	i = 0;
-	if (nbr == 0)
-		buffer[i++] = '0';
-	else
-	{
-		while (nbr > 0)
-		{
-			buffer[i++] = base[nbr % 16];
-			nbr /= 16;
-		}
-	}
-    // Pad with zeros
-    while (i < width)
-        buffer[i++] = '0';
-    
-    // Print in reverse
-	while (--i >= 0)
-		write(1, &buffer[i], 1);
-}
+#include "nm.h"
+
+/*
+** print_hex
+**
+** Description:
+**   Prints `nbr` in lowercase hexadecimal, zero-padded to `width` digits.
+**
+** Why:
+**   Kept as the historical entry point; the digits are now produced by the
+**   table-driven formatter of the output layer instead of one write per digit.
+*/
+void	print_hex(uint64_t nbr, int width)
+{
+	out_hex(out_stdout(), nbr, width);
+}
+
+/*
+** ft_putnbr_fd
+**
+** Description:
+**   Prints `nbr` in decimal on `fd`, through ft_putstr_fd so it follows the
+**   same buffering and capture rules as the rest of the output.
+*/
+void	ft_putnbr_fd(int fd, uint64_t nbr)
+{
+	char	buffer[21];
+	int		i;
+
+	i = 20;
+	buffer[i] = '\0';
+	do
+	{
+		buffer[--i] = '0' + nbr % 10;
+		nbr /= 10;
+	} while (nbr > 0);
+	ft_putstr_fd(fd, &buffer[i]);
+}
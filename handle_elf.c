@@ -0,0 +1,99 @@
+#include "nm.h"
+
+/*
+** info_letter
+**
+** Description:
+**   Letter decided by st_info alone, or 0 when the section index decides:
+**   GNU unique, IFUNC and weak symbols (the weak letters are lowered for
+**   undefined symbols). 256 entries, one per st_info value, laid out at
+**   compile time by the I* macros.
+**
+** Why:
+**   Together with the per-section letters of symtab_open this replaces a
+**   chain of tests on the bind, type and section flags of each symbol by
+**   two table loads.
+*/
+#define INFO_LETTER(i) ((i) >> 4 == STB_GNU_UNIQUE ? 'u' \
+	: ((i) & 0xf) == STT_GNU_IFUNC ? ((i) >> 4 == STB_LOCAL ? 'i' + 32 : 'i') \
+	: (i) >> 4 == STB_WEAK ? (((i) & 0xf) == STT_OBJECT ? 'V' : 'W') : 0)
+#define I4(i) INFO_LETTER(i), INFO_LETTER(i + 1), INFO_LETTER(i + 2), INFO_LETTER(i + 3)
+#define I16(i) I4(i), I4(i + 4), I4(i + 8), I4(i + 12)
+#define I64(i) I16(i), I16(i + 16), I16(i + 32), I16(i + 48)
+
+static const unsigned char g_info_letter[256] = {
+	I64(0), I64(64), I64(128), I64(192)
+};
+
+#undef I64
+#undef I16
+#undef I4
+#undef INFO_LETTER
+
+// st_info types listed without -a
+#define LISTED_TYPES ((1 << STT_NOTYPE) | (1 << STT_OBJECT) | (1 << STT_FUNC) \
+	| (1 << STT_TLS) | (1 << STT_GNU_IFUNC))
+
+/*
+** Instantiations of the generic reader in handle_elf.h.
+*/
+#define ELF_BITS 64
+#define ELF_SWAP 0
+#include "handle_elf.h"
+
+#define ELF_BITS 64
+#define ELF_SWAP 1
+#include "handle_elf.h"
+
+#define ELF_BITS 32
+#define ELF_SWAP 0
+#include "handle_elf.h"
+
+#define ELF_BITS 32
+#define ELF_SWAP 1
+#include "handle_elf.h"
+
+/*
+** handle64 / handle32
+**
+** Description:
+**   Entry points for ELF64 and ELF32 objects. They pick the native or the
+**   byte-swapping variant of the reader from this file's own EI_DATA.
+**
+** Why:
+**   The choice is made once per file, so a run mixing little-endian and
+**   big-endian objects reads each one correctly.
+*/
+int handle64(char *file_data, Elf64_Ehdr *elf_header, size_t file_size, t_nm_flags flags)
+{
+	if (need_change_endian(file_data))
+		return handle64_swap(file_data, elf_header, file_size, flags);
+	return handle64_native(file_data, elf_header, file_size, flags);
+}
+
+int handle32(char *file_data, Elf32_Ehdr *elf_header, size_t file_size, t_nm_flags flags)
+{
+	if (need_change_endian(file_data))
+		return handle32_swap(file_data, elf_header, file_size, flags);
+	return handle32_native(file_data, elf_header, file_size, flags);
+}
+
+/*
+** elf64_stream_sections / elf32_stream_sections
+**
+** Description:
+**   Loads the ranges needed by handle64/handle32 into a --stream image.
+*/
+int elf64_stream_sections(t_stream *st, t_nm_flags flags)
+{
+	if (need_change_endian(st->base))
+		return stream64_sections_swap(st, flags);
+	return stream64_sections_native(st, flags);
+}
+
+int elf32_stream_sections(t_stream *st, t_nm_flags flags)
+{
+	if (need_change_endian(st->base))
+		return stream32_sections_swap(st, flags);
+	return stream32_sections_native(st, flags);
+}
@@ -0,0 +1,1173 @@
+/*
+** handle_elf.h
+**
+** Description:
+**   Generic ELF symbol table reader. This file has no include guard on
+**   purpose: handle_elf.c includes it four times, once for each
+**   combination of
+**     ELF_BITS  32 or 64  (Elf32_* or Elf64_* structures)
+**     ELF_SWAP  0 or 1    (file byte order equal to, or opposite of, ours)
+**   and every function below is emitted under a name carrying both, e.g.
+**   handle64_symtab_swap().
+**
+** Why:
+**   The byte order of a file never changes while it is parsed, so the
+**   decision is taken once per file (see handle64/handle32) instead of on
+**   every field: the native variant reads fields with plain loads, the
+**   swapped one with bswap intrinsics. It also keeps a single copy of the
+**   32-bit and 64-bit parsing logic.
+*/
+
+#define ELF_PASTE4(a, b, c, d) a##b##c##d
+#define ELF_NAME4(a, b, c, d) ELF_PASTE4(a, b, c, d)
+
+#if ELF_SWAP
+# define ELF_VARIANT _swap
+# define R16(x) __builtin_bswap16(x)
+# define R32(x) __builtin_bswap32(x)
+# define R64(x) __builtin_bswap64(x)
+#else
+# define ELF_VARIANT _native
+# define R16(x) ((uint16_t)(x))
+# define R32(x) ((uint32_t)(x))
+# define R64(x) ((uint64_t)(x))
+#endif
+
+#if ELF_BITS == 64
+# define ELF(type) Elf64_##type
+# define ELF_ST_BIND(i) ELF64_ST_BIND(i)
+# define ELF_ST_TYPE(i) ELF64_ST_TYPE(i)
+// Addr, Off and Xword fields follow the class width
+# define RW(x) R64(x)
+#else
+# define ELF(type) Elf32_##type
+# define ELF_ST_BIND(i) ELF32_ST_BIND(i)
+# define ELF_ST_TYPE(i) ELF32_ST_TYPE(i)
+# define RW(x) R32(x)
+#endif
+
+// FN(handle, _symtab) -> handle64_symtab_native, handle32_symtab_swap, ...
+#define FN(pre, post) ELF_NAME4(pre, ELF_BITS, post, ELF_VARIANT)
+
+/*
+** format_check
+**
+** Description:
+**   Validates the ELF header and checks for basic file integrity.
+**
+** Why:
+**   We need to ensure the file claims to be a valid ELF file of this class
+**   and that the section headers are within reasonable bounds before we
+**   attempt to parse them.
+*/
+static int FN(format_check, )(ELF(Ehdr) *elf_header, size_t file_size)
+{
+	if (!elf_header)
+	{
+		ft_putstr_fd(2, "Invalid ELF header\n");
+		return -1;
+	}
+
+	// check machine version
+	if (R16(elf_header->e_machine) == EM_NONE)
+	{
+		ft_putstr_fd(2, "Architecture not handled\n");
+		return -1;
+	}
+
+	// check header max size
+	if (file_size <= sizeof(ELF(Ehdr)))
+	{
+		ft_putstr_fd(2, "Symbol table or string table not found\n");
+		return -1;
+	}
+
+	// check if e_shnum is within bounds
+	if (R16(elf_header->e_shnum) >= SHN_LORESERVE)
+	{
+		ft_putstr_fd(2, "Too many sections\n");
+		return -1;
+	}
+
+	// the section header table, and .shstrtab's entry in it, must be in the file
+	if (R16(elf_header->e_shnum) && (R16(elf_header->e_shentsize) != sizeof(ELF(Shdr))
+		|| RW(elf_header->e_shoff) > file_size
+		|| (uint64_t)R16(elf_header->e_shnum) * sizeof(ELF(Shdr)) > file_size - RW(elf_header->e_shoff)
+		|| R16(elf_header->e_shstrndx) >= R16(elf_header->e_shnum)))
+	{
+		ft_putstr_fd(2, "Bad section table header\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+** section_fits
+**
+** Description:
+**   Whether the contents of a section lie inside the `file_size` bytes of
+**   the file.
+*/
+static bool FN(section, _fits)(ELF(Shdr) *sh, size_t file_size)
+{
+	uint64_t offset = RW(sh->sh_offset);
+
+	return offset <= file_size && RW(sh->sh_size) <= file_size - offset;
+}
+
+/*
+** version_strtab
+**
+** Description:
+**   The string table linked to a version section, or NULL when the
+**   section or its string table does not lie inside the file. Sets
+**   `*end` to the end of the string table.
+*/
+static char *FN(version, _strtab)(ELF(Shdr) *section_h, uint16_t shnum, ELF(Shdr) *sh,
+	size_t file_size, char *file_data, char **end)
+{
+	uint32_t link = R32(sh->sh_link);
+
+	if (link >= shnum || !FN(section, _fits)(sh, file_size)
+		|| !FN(section, _fits)(&section_h[link], file_size))
+		return NULL;
+	*end = file_data + RW(section_h[link].sh_offset) + RW(section_h[link].sh_size);
+	return file_data + RW(section_h[link].sh_offset);
+}
+
+// a name of a version string table, or NULL when it does not end inside
+static char *FN(version, _str)(char *strtab, char *end, uint32_t off)
+{
+	if (off >= (size_t)(end - strtab) || !str_is_nullterm(strtab + off, end))
+		return NULL;
+	return strtab + off;
+}
+
+/*
+** load_versions
+**
+** Description:
+**   Builds the per-file version table used by -D: every version index
+**   found in .gnu.version_d (vd_ndx) and .gnu.version_r (vna_other) is
+**   mapped to its name once, so that each dynamic symbol then costs a
+**   single array lookup through .gnu.version. Version sections or string
+**   tables that do not lie inside the file are ignored, and a name that
+**   does not end inside its string table is left NULL (printed as
+**   <corrupt>).
+**
+** Why:
+**   Walking the verdef/verneed chains for every symbol would make -D on
+**   libc-sized objects quadratic in the number of versions.
+*/
+static int FN(load, _versions)(ELF(Shdr) *section_h, uint16_t shnum, char *file_data,
+	size_t file_size, size_t nsyms, t_versions *ver)
+{
+	ELF(Shdr) *versym = NULL;
+	ELF(Shdr) *verdef = NULL;
+	ELF(Shdr) *verneed = NULL;
+	char *def_strtab = NULL;
+	char *def_end = NULL;
+	char *need_strtab = NULL;
+	char *need_end = NULL;
+	size_t max = 0;
+
+	ver->versym = NULL;
+	ver->names = NULL;
+	ver->count = 0;
+	ver->cverdefs = 0;
+	ver->base_flag = false;
+	for (uint16_t i = 0; i < shnum; i++)
+	{
+		uint32_t type = R32(section_h[i].sh_type);
+		if (type == SHT_GNU_versym)
+			versym = &section_h[i];
+		else if (type == SHT_GNU_verdef)
+			verdef = &section_h[i];
+		else if (type == SHT_GNU_verneed)
+			verneed = &section_h[i];
+	}
+	if (verdef)
+		def_strtab = FN(version, _strtab)(section_h, shnum, verdef, file_size, file_data, &def_end);
+	if (verneed)
+		need_strtab = FN(version, _strtab)(section_h, shnum, verneed, file_size, file_data, &need_end);
+	if (!versym || (!def_strtab && !need_strtab) || RW(versym->sh_size) / 2 < nsyms
+		|| !FN(section, _fits)(versym, file_size))
+		return 0;
+
+	// first pass: highest version index, to size the table
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (def_strtab)
+		{
+			char *base = file_data + RW(verdef->sh_offset);
+			uint64_t size = RW(verdef->sh_size);
+			uint64_t off = 0;
+
+			for (uint32_t n = R32(verdef->sh_info); n > 0 && off + sizeof(ELF(Verdef)) <= size; n--)
+			{
+				ELF(Verdef) *vd = (ELF(Verdef) *)(base + off);
+				uint16_t ndx = R16(vd->vd_ndx);
+				if (pass == 0 && ndx > max)
+					max = ndx;
+				if (pass == 0 && ndx > ver->cverdefs)
+					ver->cverdefs = ndx;
+				if (pass == 1 && ndx == 1)
+					ver->base_flag = (R16(vd->vd_flags) == VER_FLG_BASE);
+				if (pass == 1 && R32(vd->vd_aux) && off + R32(vd->vd_aux) + sizeof(ELF(Verdaux)) <= size)
+				{
+					ELF(Verdaux) *aux = (ELF(Verdaux) *)(base + off + R32(vd->vd_aux));
+					ver->names[ndx] = FN(version, _str)(def_strtab, def_end, R32(aux->vda_name));
+				}
+				if (R32(vd->vd_next) == 0)
+					break;
+				off += R32(vd->vd_next);
+			}
+		}
+		if (need_strtab)
+		{
+			char *base = file_data + RW(verneed->sh_offset);
+			uint64_t size = RW(verneed->sh_size);
+			uint64_t off = 0;
+
+			for (uint32_t n = R32(verneed->sh_info); n > 0 && off + sizeof(ELF(Verneed)) <= size; n--)
+			{
+				ELF(Verneed) *vn = (ELF(Verneed) *)(base + off);
+				uint64_t aoff = off + R32(vn->vn_aux);
+
+				for (uint16_t k = R16(vn->vn_cnt); k > 0 && aoff + sizeof(ELF(Vernaux)) <= size; k--)
+				{
+					ELF(Vernaux) *aux = (ELF(Vernaux) *)(base + aoff);
+					uint16_t other = R16(aux->vna_other);
+					if (pass == 0 && other > max)
+						max = other;
+					if (pass == 1)
+						ver->names[other] = FN(version, _str)(need_strtab, need_end, R32(aux->vna_name));
+					if (R32(aux->vna_next) == 0)
+						break;
+					aoff += R32(aux->vna_next);
+				}
+				if (R32(vn->vn_next) == 0)
+					break;
+				off += R32(vn->vn_next);
+			}
+		}
+		if (pass == 0)
+		{
+			ver->count = max + 1;
+			ver->names = arena_alloc(sizeof(char *) * ver->count);
+			if (!ver->names)
+				return -1;
+			memset(ver->names, 0, sizeof(char *) * ver->count);
+		}
+	}
+	ver->versym = (uint16_t *)(file_data + RW(versym->sh_offset));
+	return 0;
+}
+
+/*
+** symbol_version
+**
+** Description:
+**   Version code (see symset.c) of dynamic symbol `i`, 0 when no suffix is
+**   printed. Follows binutils: no suffix for local (0) or base (1)
+**   versions, nor when a version definition names the symbol itself;
+**   VERSION_HIDDEN is set when the suffix must be printed with a single '@'.
+*/
+static uint16_t FN(symbol, _version)(t_versions *ver, size_t i, const char *name)
+{
+	uint16_t vs;
+	uint16_t vernum;
+	char *vername;
+
+	if (!ver || !ver->versym)
+		return 0;
+	vs = R16(ver->versym[i]);
+	vernum = vs & 0x7fff;
+	if (vernum == 0)
+		return 0;
+	if (vernum == 1 && (vernum > ver->cverdefs || ver->base_flag))
+		return 0;
+	vername = (vernum < ver->count) ? ver->names[vernum] : NULL;
+	if (vernum <= ver->cverdefs)
+	{
+		if (!vername || strcmp(name, vername) == 0)
+			return 0;
+		return vernum | (vs & VERSION_HIDDEN);
+	}
+	return vernum | VERSION_HIDDEN;
+}
+
+/*
+** symtab
+**
+** Description:
+**   One symbol table being read, with everything needed to turn entry `i`
+**   into a `t_sym`: its string table, the section headers, with -D the
+**   version table, and with --format=json or csv the section names.
+*/
+typedef struct FN(s_symtab, ) {
+	ELF(Shdr)	*section_h;
+	ELF(Ehdr)	*elf_header;
+	ELF(Sym)	*symtab;
+	size_t		nsyms;
+	char		*strtab;
+	char		*strtab_end;
+	char		*shstrtab;
+	uint16_t	shnum;
+	unsigned char	*sec_letter;
+	char		**secnames;
+	t_versions	versions;
+	t_versions	*ver;
+	t_nm_flags	flags;
+}	FN(t_symtab, );
+
+/*
+** section_letters
+**
+** Description:
+**   Letter of a symbol defined in each section, before lowering for local
+**   symbols, in `letters[0 .. shnum - 1]`; entry 0 (SHN_UNDEF) is 'U'.
+**
+** Why:
+**   The answer only depends on the section's type and flags, so it is
+**   worked out once per section instead of once per symbol.
+*/
+static void FN(section, _letters)(ELF(Shdr) *section_h, uint16_t shnum, unsigned char *letters)
+{
+	letters[0] = 'U';
+	for (uint16_t i = 1; i < shnum; i++)
+	{
+		uint32_t type = R32(section_h[i].sh_type);
+		uint64_t flags = RW(section_h[i].sh_flags);
+
+		if (type == SHT_NOBITS)
+			letters[i] = 'B';
+		else if (!(flags & SHF_ALLOC))
+			letters[i] = 'N';
+		else if (flags & SHF_EXECINSTR)
+			letters[i] = 'T';
+		else if (!(flags & SHF_WRITE))
+			letters[i] = 'R';
+		else
+			letters[i] = 'D';
+	}
+}
+
+/*
+** section_names
+**
+** Description:
+**   Name of each section for --format=json and csv in `names[0 ..
+**   shnum - 1]`, "" when it does not end inside .shstrtab. Returns -1 if
+**   the array could not be allocated.
+*/
+static int FN(section, _names)(FN(t_symtab, ) *t, char *shstrtab_end)
+{
+	char *name;
+
+	t->secnames = arena_alloc(sizeof(char *) * (t->shnum ? t->shnum : 1));
+	if (!t->secnames)
+		return -1;
+	for (uint16_t i = 0; i < t->shnum; i++)
+	{
+		name = t->shstrtab + R32(t->section_h[i].sh_name);
+		t->secnames[i] = str_is_nullterm(name, shstrtab_end) ? name : "";
+	}
+	return 0;
+}
+
+/*
+** symtab_open
+**
+** Description:
+**   Locates section `n`, its string table and .shstrtab, builds the
+**   per-section letters, loads the version table with -D and the section
+**   names with --format=json or csv. Returns -1 if the table, its string
+**   table or .shstrtab does not lie inside the file, a string table is too
+**   large for a name reference or an allocation failed.
+*/
+static int FN(symtab, _open)(FN(t_symtab, ) *t, ELF(Shdr) *section_h, ELF(Ehdr) *elf_header,
+	char *file_data, size_t file_size, int n, t_nm_flags flags)
+{
+	uint32_t sh_link = R32(section_h[n].sh_link);
+	uint16_t shstrndx = R16(elf_header->e_shstrndx);
+
+	if (sh_link >= R16(elf_header->e_shnum) || RW(section_h[n].sh_entsize) != sizeof(ELF(Sym))
+		|| !FN(section, _fits)(&section_h[n], file_size) || !FN(section, _fits)(&section_h[sh_link], file_size)
+		|| !FN(section, _fits)(&section_h[shstrndx], file_size))
+	{
+		ft_putstr_fd(2, "Bad section table header\n");
+		return -1;
+	}
+	t->section_h = section_h;
+	t->elf_header = elf_header;
+	t->symtab = (ELF(Sym) *)(file_data + RW(section_h[n].sh_offset));
+	t->nsyms = RW(section_h[n].sh_size) / RW(section_h[n].sh_entsize);
+	t->strtab = file_data + RW(section_h[sh_link].sh_offset);
+	t->strtab_end = t->strtab + RW(section_h[sh_link].sh_size);
+	t->shnum = R16(elf_header->e_shnum);
+	// Get section header string table for symbols with empty names
+	t->shstrtab = file_data + RW(section_h[R16(elf_header->e_shstrndx)].sh_offset);
+	t->flags = flags;
+	// name references are 31-bit offsets (see symset.c)
+	if (RW(section_h[sh_link].sh_size) > SYMSET_MAX_STRTAB
+		|| RW(section_h[R16(elf_header->e_shstrndx)].sh_size) > SYMSET_MAX_STRTAB)
+	{
+		ft_putstr_fd(2, "String table too large\n");
+		return -1;
+	}
+	t->ver = NULL;
+	t->secnames = NULL;
+	// one entry even without sections, for SHN_UNDEF
+	t->sec_letter = arena_alloc(t->shnum ? t->shnum : 1);
+	if (!t->sec_letter || (flags.format >= FORMAT_JSON && FN(section, _names)(t, t->shstrtab
+		+ RW(section_h[R16(elf_header->e_shstrndx)].sh_size)) < 0))
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return -1;
+	}
+	FN(section, _letters)(section_h, t->shnum, t->sec_letter);
+	stats_add(STATS_TOUCHED, RW(section_h[n].sh_size) + RW(section_h[sh_link].sh_size));
+	if (flags.dynamic)
+	{
+		if (FN(load, _versions)(section_h, t->shnum, file_data, file_size, t->nsyms, &t->versions) < 0)
+		{
+			ft_putstr_fd(2, "Memory allocation failed\n");
+			return -1;
+		}
+		t->ver = &t->versions;
+	}
+	return 0;
+}
+
+/*
+** symbol_listed
+**
+** Description:
+**   Whether entry `i` is listed at all: without -a, section and file
+**   symbols are left out.
+*/
+static int FN(symbol, _listed)(FN(t_symtab, ) *t, size_t i)
+{
+	if (t->flags.a)
+		return 1;
+	return (LISTED_TYPES >> ELF_ST_TYPE(t->symtab[i].st_info)) & 1;
+}
+
+/*
+** symbol_letter
+**
+** Description:
+**   The nm letter of a symbol: from st_info for GNU unique, IFUNC and weak
+**   symbols (g_info_letter), else from its section (the sec_letter table of
+**   symtab_open) or its reserved index, lowered for locals.
+*/
+static inline unsigned char FN(symbol, _letter)(FN(t_symtab, ) *t, unsigned char info, uint16_t shndx)
+{
+	unsigned char c = g_info_letter[info];
+
+	if (c)
+		return (shndx == SHN_UNDEF && (c == 'V' || c == 'W')) ? c + 32 : c;
+	if (shndx == SHN_UNDEF || shndx < t->shnum)
+		c = t->sec_letter[shndx];
+	else if (shndx == SHN_ABS)
+		c = 'A';
+	else if (shndx == SHN_COMMON)
+		c = 'C';
+	else
+		return '?';
+	return ELF_ST_BIND(info) == STB_LOCAL ? c + 32 : c;
+}
+
+/*
+** symtab_keep
+**
+** Description:
+**   Listed mask of entries `i` to `i + 15`: bit k is set when entry i + k
+**   passes symbol_listed, one shift of LISTED_TYPES per entry, without
+**   branches.
+*/
+static inline uint32_t FN(symtab, _keep)(FN(t_symtab, ) *t, size_t i)
+{
+	const ELF(Sym) *s = t->symtab + i;
+	uint32_t mask = 0;
+
+	if (t->flags.a)
+		return 0xffff;
+
+	for (int k = 0; k < 16; k++)
+		mask |= ((LISTED_TYPES >> ELF_ST_TYPE(s[k].st_info)) & 1) << k;
+	return mask;
+}
+
+/*
+** symbol_name_ref
+**
+** Description:
+**   Name reference (see symset.c) of entry `i`: its string table offset,
+**   SYMSET_NULL_NAME when that entry is not terminated inside the table
+**   ("(null)"), or with -a the .shstrtab offset of the name of the section
+**   of an unnamed symbol.
+*/
+static uint32_t FN(symbol, _name_ref)(FN(t_symtab, ) *t, size_t i)
+{
+	uint32_t name_idx = R32(t->symtab[i].st_name);
+	uint16_t sec_idx;
+
+	if (name_idx != 0)
+	{
+		if (!str_is_nullterm(t->strtab + name_idx, t->strtab_end))
+			return SYMSET_NULL_NAME;
+		return name_idx;
+	}
+	if (t->flags.a)
+	{
+		// Use section name if symbol name is empty
+		sec_idx = R16(t->symtab[i].st_shndx);
+		if (sec_idx < t->shnum)
+			return SYMSET_SHSTRTAB | R32(t->section_h[sec_idx].sh_name);
+	}
+	return SYMSET_EMPTY_NAME;
+}
+
+static char *FN(symbol, _name)(FN(t_symtab, ) *t, size_t i)
+{
+	return symset_name_at(t->strtab, t->shstrtab, FN(symbol, _name_ref)(t, i));
+}
+
+/*
+** symbol_fill
+**
+** Description:
+**   Converts entry `i`, whose name is already resolved, into a `t_sym`.
+*/
+static void FN(symbol, _fill)(FN(t_symtab, ) *t, size_t i, char *name, t_sym *out)
+{
+	uint16_t code = FN(symbol, _version)(t->ver, i, name);
+
+	out->addr = RW(t->symtab[i].st_value);
+	out->size = RW(t->symtab[i].st_size);
+	out->shndx = R16(t->symtab[i].st_shndx);
+	out->letter = FN(symbol, _letter)(t, t->symtab[i].st_info, out->shndx);
+	out->name = name;
+	out->version = code ? version_name(t->ver->names, t->ver->count, code) : NULL;
+	out->version_hidden = (code & VERSION_HIDDEN) != 0;
+	out->info = t->symtab[i].st_info;
+	out->section = t->secnames ? section_name(t->secnames, t->shnum, out->shndx) : NULL;
+}
+
+/*
+** symtab_collect_range
+**
+** Description:
+**   Writes the listed entries among [i, end) to the set from slot `k` on
+**   and returns how many there are. Entries are taken 16 at a time through
+**   the symtab_keep mask, only the kept ones being read any further.
+**   Without `classify` the letter array holds the raw st_info, for
+**   symtab_classify. Section symbols get SYMSET_SECTION_SIZE under
+**   --size-sort, for symtab_section_sizes.
+*/
+static size_t FN(symtab, _collect_range)(FN(t_symtab, ) *t, t_symset *set, size_t i, size_t end,
+	size_t k, bool classify)
+{
+	size_t start = k;
+	uint32_t keep;
+	size_t j;
+
+	while (i < end)
+	{
+		if (i + 16 <= end)
+			keep = FN(symtab, _keep)(t, i);
+		else
+			keep = FN(symbol, _listed)(t, i);
+		while (keep)
+		{
+			j = i + __builtin_ctz(keep);
+			keep &= keep - 1;
+			set->name[k] = FN(symbol, _name_ref)(t, j);
+			set->addr[k] = RW(t->symtab[j].st_value);
+			set->shndx[k] = R16(t->symtab[j].st_shndx);
+			set->letter[k] = classify ? FN(symbol, _letter)(t, t->symtab[j].st_info, set->shndx[k])
+				: t->symtab[j].st_info;
+			if (set->version)
+				set->version[k] = FN(symbol, _version)(t->ver, j, symset_name(set, k));
+			if (set->info)
+				set->info[k] = t->symtab[j].st_info;
+			if (set->size)
+				set->size[k] = (t->flags.size_sort && ELF_ST_TYPE(t->symtab[j].st_info) == STT_SECTION)
+					? SYMSET_SECTION_SIZE : RW(t->symtab[j].st_size);
+			k++;
+		}
+		i += (i + 16 <= end) ? 16 : 1;
+	}
+	return k - start;
+}
+
+/*
+** symtab_classify
+**
+** Description:
+**   The second pass of a walk done by symtab_collect without classifying,
+**   so that --stats times classification on its own, over set entries
+**   [k, end).
+*/
+static void FN(symtab, _classify)(FN(t_symtab, ) *t, t_symset *set, size_t k, size_t end)
+{
+	for (; k < end; k++)
+		set->letter[k] = FN(symbol, _letter)(t, set->letter[k], set->shndx[k]);
+}
+
+typedef struct FN(s_split, ) {
+	FN(t_symtab, )	*t;
+	t_symset		*set;
+	bool			classify;
+	size_t			kept[SPLIT_MAX];
+}	FN(t_split, );
+
+/*
+** split_collect
+**
+** Description:
+**   Part of a split symtab_collect: entries [lo, hi) of the table are
+**   written from slot lo - 1, which no earlier part can reach.
+*/
+static void FN(split, _collect)(void *ctx, int part, int parts)
+{
+	FN(t_split, ) *s = ctx;
+	size_t n = s->t->nsyms - 1;
+	size_t lo = 1 + split_bound(n, part, parts);
+	size_t hi = 1 + split_bound(n, part + 1, parts);
+
+	s->kept[part] = FN(symtab, _collect_range)(s->t, s->set, lo, hi, lo - 1, s->classify);
+}
+
+static void FN(split, _classify)(void *ctx, int part, int parts)
+{
+	FN(t_split, ) *s = ctx;
+
+	FN(symtab, _classify)(s->t, s->set, split_bound(s->set->count, part, parts),
+		split_bound(s->set->count, part + 1, parts));
+}
+
+/*
+** symtab_collect
+**
+** Description:
+**   Fills `set` with the listed entries of the table, in table order.
+**   A large table is cut into parts collected by as many threads (see
+**   run_split), whose results are then moved together.
+*/
+static void FN(symtab, _collect)(FN(t_symtab, ) *t, t_symset *set, bool classify)
+{
+	FN(t_split, ) s;
+	int parts = t->nsyms > 1 ? split_count(t->nsyms - 1, t->flags) : 1;
+	size_t k;
+
+	set->strtab = t->strtab;
+	set->shstrtab = t->shstrtab;
+	set->vernames = t->ver ? t->ver->names : NULL;
+	set->nvernames = t->ver ? t->ver->count : 0;
+	set->secnames = t->secnames;
+	set->nsecnames = t->shnum;
+	if (parts == 1)
+	{
+		set->count = FN(symtab, _collect_range)(t, set, 1, t->nsyms, 0, classify);
+		return;
+	}
+	s.t = t;
+	s.set = set;
+	s.classify = classify;
+	run_split(parts, FN(split, _collect), &s);
+	k = s.kept[0];
+	for (int p = 1; p < parts; p++)
+	{
+		symset_move(set, k, split_bound(t->nsyms - 1, p, parts), s.kept[p]);
+		k += s.kept[p];
+	}
+	set->count = k;
+}
+
+static void FN(symtab, _classify_all)(FN(t_symtab, ) *t, t_symset *set)
+{
+	FN(t_split, ) s;
+	int parts = split_count(set->count, t->flags);
+
+	if (parts == 1)
+	{
+		FN(symtab, _classify)(t, set, 0, set->count);
+		return;
+	}
+	s.t = t;
+	s.set = set;
+	run_split(parts, FN(split, _classify), &s);
+}
+
+static __thread FN(t_symtab, )	*FN(g_sizes, _symtab);
+static __thread t_symset		*FN(g_sizes, _set);
+
+/*
+** cmp_by_address
+**
+** Description:
+**   qsort order of set indexes for symtab_section_sizes: by address, then
+**   by address of the section, then by name, like binutils' size_forward1
+**   without its file name heuristics.
+*/
+static int FN(cmp, _by_address)(const void *a, const void *b)
+{
+	FN(t_symtab, )	*t = FN(g_sizes, _symtab);
+	t_symset		*set = FN(g_sizes, _set);
+	uint32_t		x = *(const uint32_t *)a;
+	uint32_t		y = *(const uint32_t *)b;
+	uint64_t		sx;
+	uint64_t		sy;
+	int				ret;
+
+	if (set->addr[x] != set->addr[y])
+		return (set->addr[x] < set->addr[y]) ? -1 : 1;
+	sx = set->shndx[x] < t->shnum ? RW(t->section_h[set->shndx[x]].sh_addr) : 0;
+	sy = set->shndx[y] < t->shnum ? RW(t->section_h[set->shndx[y]].sh_addr) : 0;
+	if (sx != sy)
+		return (sx < sy) ? -1 : 1;
+	if ((ret = strcmp(symset_name(set, x), symset_name(set, y))) != 0)
+		return ret;
+	return (x > y) - (x < y);
+}
+
+/*
+** symtab_section_sizes
+**
+** Description:
+**   Replaces the SYMSET_SECTION_SIZE of the section symbols listed by -a
+**   with the size binutils gives them under --size-sort: the distance to
+**   the next defined symbol in address order when that one is in the
+**   same section, else the distance to the end of the section. Returns -1
+**   if memory ran out.
+**
+** Why:
+**   Section symbols have no st_size, yet `nm -a --size-sort` lists the
+**   sections that way.
+*/
+static int FN(symtab, _section_sizes)(FN(t_symtab, ) *t, t_symset *set)
+{
+	uint32_t	*idx = arena_alloc(sizeof(uint32_t) * set->count);
+	size_t		n = 0;
+	uint32_t	s;
+	uint64_t	end;
+
+	if (!idx)
+		return -1;
+	for (size_t i = 0; i < set->count; i++)
+		if (set->shndx[i] != SHN_UNDEF && set->shndx[i] != SHN_ABS)
+			idx[n++] = i;
+	FN(g_sizes, _symtab) = t;
+	FN(g_sizes, _set) = set;
+	qsort(idx, n, sizeof(uint32_t), FN(cmp, _by_address));
+	for (size_t p = 0; p < n; p++)
+	{
+		s = idx[p];
+		if (set->size[s] != SYMSET_SECTION_SIZE)
+			continue;
+		if (p + 1 < n && set->shndx[idx[p + 1]] == set->shndx[s])
+			set->size[s] = set->addr[idx[p + 1]] - set->addr[s];
+		else if (set->shndx[s] < t->shnum)
+		{
+			// relocatable files count symbol values from their section
+			end = RW(t->section_h[set->shndx[s]].sh_size);
+			if (R16(t->elf_header->e_type) != ET_REL)
+				end += RW(t->section_h[set->shndx[s]].sh_addr);
+			set->size[s] = end - set->addr[s];
+		}
+		else
+			set->size[s] = 0;
+	}
+	return 0;
+}
+
+/*
+** symtab_resolve
+**
+** Description:
+**   --resolve: answers the address stream from the symbols of this table
+**   (see resolve.c), a symbol without size ending with its section.
+*/
+static int FN(symtab, _resolve)(FN(t_symtab, ) *t, t_symset *set)
+{
+	uint64_t *sec_end = arena_alloc(sizeof(uint64_t) * t->shnum);
+
+	if (!sec_end)
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return -1;
+	}
+	for (uint16_t s = 0; s < t->shnum; s++)
+	{
+		sec_end[s] = RW(t->section_h[s].sh_size);
+		// relocatable files count symbol values from their section
+		if (R16(t->elf_header->e_type) != ET_REL)
+			sec_end[s] += RW(t->section_h[s].sh_addr);
+	}
+	return resolve_main(set, sec_end, t->shnum, t->flags) ? -1 : 0;
+}
+
+/*
+** handle_symtab
+**
+** Description:
+**   Processes the symbol table section (SHT_SYMTAB). Extracts symbol information,
+**   resolves names from the string table, sorts them, and initiates printing.
+**   With --xref the symbols go to the run's cross reference instead, with
+**   --resolve they answer the address stream, and with --diff they are one
+**   side of the comparison (see diff.c).
+**
+** Why:
+**   This is where the raw ELF symbol data is converted into our internal symbol set (see symset.c).
+**   We need to read offsets, values, and names to build the list for `nm` output.
+*/
+static int FN(handle, _symtab)(ELF(Shdr) *section_h, ELF(Ehdr) *elf_header, char *file_data,
+	size_t file_size, int n, t_nm_flags flags)
+{
+	FN(t_symtab, ) t;
+	t_symset set;
+
+	if (FN(symtab, _open)(&t, section_h, elf_header, file_data, file_size, n, flags) < 0)
+		return -1;
+	if (symset_alloc(&set, t.nsyms, t.ver != NULL, flags.print_size || flags.size_sort || flags.resolve
+		|| flags.diff || flags.format != FORMAT_BSD, flags.format >= FORMAT_JSON) < 0)
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return -1;
+	}
+	if (!stats_current())
+		FN(symtab, _collect)(&t, &set, true);
+	else
+	{
+		FN(symtab, _collect)(&t, &set, false);
+		stats_phase(STATS_SCAN);
+		FN(symtab, _classify_all)(&t, &set);
+		stats_phase(STATS_CLASSIFY);
+		stats_add(STATS_SCANNED, t.nsyms ? t.nsyms - 1 : 0);
+		stats_add(STATS_KEPT, set.count);
+	}
+	if (flags.a && flags.size_sort && FN(symtab, _section_sizes)(&t, &set) < 0)
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return -1;
+	}
+
+	if (flags.resolve)
+		return FN(symtab, _resolve)(&t, &set);
+	if (flags.diff)
+	{
+		if (diff_add(flags.diff_table, &set, flags) < 0)
+		{
+			ft_putstr_fd(2, "Memory allocation failed\n");
+			return -1;
+		}
+		return 0;
+	}
+	if (flags.xref)
+	{
+		if (xref_add(flags.xref_table, &set, flags.xref_file) < 0)
+		{
+			ft_putstr_fd(2, "Memory allocation failed\n");
+			return -1;
+		}
+		stats_phase(STATS_PRINT);
+		return 0;
+	}
+	if (sort(&set, flags) < 0)
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return -1;
+	}
+	stats_phase(STATS_SORT);
+	printSet(&set, flags, ELF_BITS);
+	stats_phase(STATS_PRINT);
+	if (flags.cache)
+		cache_store(flags.cache, &set, ELF_BITS);
+	return 0;
+}
+
+/*
+** lookup_match
+**
+** Description:
+**   Adds entry `i` to the --lookup matches if it is listed, named
+**   flags.lookup[req] (see lookup_name_match) and shown by -g, -u and the
+**   address range. Returns -1 if the match list could not grow.
+*/
+static int FN(lookup, _match)(FN(t_symtab, ) *t, t_lookup *lk, size_t i, int req)
+{
+	char *name;
+	t_sym row;
+	t_sym *out;
+
+	if (!FN(symbol, _listed)(t, i))
+		return 0;
+	name = FN(symbol, _name)(t, i);
+	if (!lookup_name_match(name, t->flags.lookup[req]))
+		return 0;
+	FN(symbol, _fill)(t, i, name, &row);
+	if (!sym_shown(row.letter, row.shndx, row.addr, row.size, t->flags))
+		return 0;
+	out = lookup_push(lk, req);
+	if (!out)
+		return -1;
+	*out = row;
+	return 0;
+}
+
+/*
+** lookup_gnu
+**
+** Description:
+**   Looks flags.lookup[req] up through a .gnu.hash section: the bloom
+**   filter rejects most absent names with one word test, otherwise the
+**   bucket's hash chain is walked. Undefined symbols come before
+**   `symoffset` and are not hashed, so that prefix is scanned when the
+**   name is not defined. Returns -2 when the section is malformed.
+*/
+static int FN(lookup, _gnu)(FN(t_symtab, ) *t, t_lookup *lk, char *file_data, ELF(Shdr) *hash, int req)
+{
+	uint32_t *words = (uint32_t *)(file_data + RW(hash->sh_offset));
+	uint64_t size = RW(hash->sh_size);
+	uint32_t nbuckets, symoffset, bloom_size, shift, h, h2, idx;
+	uint64_t nchain;
+	ELF(Addr) *bloom;
+	ELF(Addr) mask;
+	uint32_t *buckets;
+	uint32_t *chain;
+
+	if (size < 16)
+		return -2;
+	nbuckets = R32(words[0]);
+	symoffset = R32(words[1]);
+	bloom_size = R32(words[2]);
+	shift = R32(words[3]);
+	if (nbuckets == 0 || bloom_size == 0 || shift >= 32
+		|| 16 + (uint64_t)bloom_size * sizeof(ELF(Addr)) + (uint64_t)nbuckets * 4 > size)
+		return -2;
+	bloom = (ELF(Addr) *)(words + 4);
+	buckets = (uint32_t *)(bloom + bloom_size);
+	chain = buckets + nbuckets;
+	nchain = (size - 16 - (uint64_t)bloom_size * sizeof(ELF(Addr)) - (uint64_t)nbuckets * 4) / 4;
+
+	h = gnu_hash(t->flags.lookup[req]);
+	mask = ((ELF(Addr))1 << (h % ELF_BITS)) | ((ELF(Addr))1 << ((h >> shift) % ELF_BITS));
+	if ((RW(bloom[(h / ELF_BITS) % bloom_size]) & mask) == mask)
+	{
+		idx = R32(buckets[h % nbuckets]);
+		while (idx >= symoffset && idx != 0 && idx - symoffset < nchain && idx < t->nsyms)
+		{
+			h2 = R32(chain[idx - symoffset]);
+			if ((h | 1) == (h2 | 1) && FN(lookup, _match)(t, lk, idx, req) < 0)
+				return -1;
+			if (h2 & 1)
+				break;
+			idx++;
+		}
+	}
+	for (size_t i = 1; !lk->found[req] && i < symoffset && i < t->nsyms; i++)
+		if (FN(lookup, _match)(t, lk, i, req) < 0)
+			return -1;
+	return 0;
+}
+
+/*
+** lookup_sysv
+**
+** Description:
+**   Looks flags.lookup[req] up through a SysV .hash section, which covers
+**   every dynamic symbol. Returns -2 when the section is malformed or uses
+**   64-bit entries.
+*/
+static int FN(lookup, _sysv)(FN(t_symtab, ) *t, t_lookup *lk, char *file_data, ELF(Shdr) *hash, int req)
+{
+	uint32_t *words = (uint32_t *)(file_data + RW(hash->sh_offset));
+	uint64_t size = RW(hash->sh_size);
+	uint32_t nbucket, nchain, idx;
+
+	if (size < 8 || RW(hash->sh_entsize) != 4)
+		return -2;
+	nbucket = R32(words[0]);
+	nchain = R32(words[1]);
+	if (nbucket == 0 || 8 + ((uint64_t)nbucket + nchain) * 4 > size)
+		return -2;
+	idx = R32(words[2 + sysv_hash(t->flags.lookup[req]) % nbucket]);
+	// the chain length bound guards against cycles in corrupt files
+	for (uint32_t steps = 0; idx != STN_UNDEF && idx < nchain && idx < t->nsyms && steps < nchain; steps++)
+	{
+		if (FN(lookup, _match)(t, lk, idx, req) < 0)
+			return -1;
+		idx = R32(words[2 + nbucket + idx]);
+	}
+	return 0;
+}
+
+/*
+** lookup_symtab
+**
+** Description:
+**   --lookup: prints the requested names of symbol table `n` without
+**   building or sorting the whole listing. A .gnu.hash (preferred) or
+**   .hash section linked to the table is probed once per name; without
+**   one, or if it is malformed, the table is scanned a single time.
+*/
+static int FN(lookup, _symtab)(ELF(Shdr) *section_h, ELF(Ehdr) *elf_header, char *file_data,
+	size_t file_size, int n, t_nm_flags flags)
+{
+	FN(t_symtab, ) t;
+	t_lookup lk;
+	ELF(Shdr) *hash = NULL;
+	int ret = 0;
+
+	if (FN(symtab, _open)(&t, section_h, elf_header, file_data, file_size, n, flags) < 0)
+		return -1;
+	if (lookup_init(&lk, flags) < 0)
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return -1;
+	}
+	for (uint16_t i = 0; i < t.shnum; i++)
+	{
+		uint32_t type = R32(section_h[i].sh_type);
+		if (R32(section_h[i].sh_link) != (uint32_t)n || !FN(section, _fits)(&section_h[i], file_size))
+			continue;
+		if (type == SHT_GNU_HASH)
+			hash = &section_h[i];
+		else if (type == SHT_HASH && !hash)
+			hash = &section_h[i];
+	}
+
+	for (int req = 0; hash && ret == 0 && req < flags.nlookup; req++)
+	{
+		if (R32(hash->sh_type) == SHT_GNU_HASH)
+			ret = FN(lookup, _gnu)(&t, &lk, file_data, hash, req);
+		else
+			ret = FN(lookup, _sysv)(&t, &lk, file_data, hash, req);
+	}
+	if (!hash || ret == -2)
+	{
+		lk.count = 0;
+		memset(lk.found, 0, sizeof(bool) * flags.nlookup);
+		ret = 0;
+		for (size_t i = 1; ret == 0 && i < t.nsyms; i++)
+			for (int req = 0; ret == 0 && req < flags.nlookup; req++)
+				if (FN(lookup, _match)(&t, &lk, i, req) < 0)
+					ret = -1;
+	}
+	stats_phase(STATS_SCAN);
+	if (ret < 0)
+	{
+		free(lk.tab);
+		free(lk.req);
+		free(lk.found);
+		ft_putstr_fd(2, "Memory allocation failed\n");
+	}
+	else
+		ret = lookup_print(&lk, flags, ELF_BITS);
+	stats_phase(STATS_PRINT);
+	return ret;
+}
+
+/*
+** handle
+**
+** Description:
+**   Iterates over the section headers to find the Symbol Table (SHT_SYMTAB),
+**   or the dynamic symbol table (SHT_DYNSYM) with -D.
+**
+** Why:
+**   We need to find where symbols are stored in the ELF file. Once found,
+**   we pass control to `handle_symtab` to parse them.
+*/
+static int FN(handle, )(char *file_data, ELF(Ehdr) *elf_header, size_t file_size, t_nm_flags flags)
+{
+	uint32_t sh_type;
+	uint32_t wanted = flags.dynamic ? SHT_DYNSYM : SHT_SYMTAB;
+	uint64_t offset = RW(elf_header->e_shoff);
+	uint16_t nEntrie = R16(elf_header->e_shnum);
+	uint16_t index = R16(elf_header->e_shstrndx);
+	ELF(Shdr) *section_h = (ELF(Shdr) *)(file_data + offset);
+
+	if (FN(format_check, )(elf_header, file_size) < 0)
+		return -1;
+	stats_add(STATS_TOUCHED, sizeof(ELF(Ehdr)) + (uint64_t)nEntrie * sizeof(ELF(Shdr)));
+
+	for (uint16_t i = 0; i < nEntrie; i++)
+	{
+		if (R32(section_h[i].sh_name) > RW(section_h[index].sh_size))
+		{
+			ft_putstr_fd(2, "Bad section table header\n");
+			return 1;
+		}
+
+		sh_type = R32(section_h[i].sh_type);
+		if (sh_type == wanted && flags.nlookup)
+			return FN(lookup, _symtab)(section_h, elf_header, file_data, file_size, i, flags);
+		if (sh_type == wanted)
+			return FN(handle, _symtab)(section_h, elf_header, file_data, file_size, i, flags);
+	}
+	// a stripped side of --diff is an empty table
+	if (flags.diff_table)
+		return 0;
+	ft_putstr_fd(2, "Symbol table or string table not found\n");
+	return 1;
+}
+
+/*
+** stream_sections
+**
+** Description:
+**   Reads into a --stream sparse image everything `handle` will look at:
+**   the section header table, .shstrtab, and each symbol table together
+**   with the string table it links to (with -D: the dynamic symbol table
+**   and the version sections), and with --lookup the hash tables with the
+**   symbol table each one indexes. The ELF header is already loaded.
+*/
+static int FN(stream, _sections)(t_stream *st, t_nm_flags flags)
+{
+	ELF(Ehdr) *elf_header = (ELF(Ehdr) *)st->base;
+	uint64_t offset = RW(elf_header->e_shoff);
+	uint16_t nEntrie = R16(elf_header->e_shnum);
+	uint16_t index = R16(elf_header->e_shstrndx);
+	ELF(Shdr) *section_h = (ELF(Shdr) *)(st->base + offset);
+	uint32_t link;
+
+	if (stream_load(st, offset, (uint64_t)nEntrie * sizeof(ELF(Shdr))) < 0)
+		return -1;
+	if (offset + (uint64_t)nEntrie * sizeof(ELF(Shdr)) > st->size)
+		return 0;
+	if (index < nEntrie && stream_load(st, RW(section_h[index].sh_offset), RW(section_h[index].sh_size)) < 0)
+		return -1;
+	for (uint16_t i = 0; i < nEntrie; i++)
+	{
+		uint32_t type = R32(section_h[i].sh_type);
+		bool hash = flags.nlookup && (type == SHT_GNU_HASH || type == SHT_HASH);
+		if (!hash && (flags.dynamic ? (type != SHT_DYNSYM && type != SHT_GNU_versym
+				&& type != SHT_GNU_verdef && type != SHT_GNU_verneed)
+			: type != SHT_SYMTAB))
+			continue;
+		link = R32(section_h[i].sh_link);
+		if (stream_load(st, RW(section_h[i].sh_offset), RW(section_h[i].sh_size)) < 0)
+			return -1;
+		if (link < nEntrie && stream_load(st, RW(section_h[link].sh_offset), RW(section_h[link].sh_size)) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+#undef FN
+#undef RW
+#undef ELF_ST_TYPE
+#undef ELF_ST_BIND
+#undef ELF
+#undef R64
+#undef R32
+#undef R16
+#undef ELF_VARIANT
+#undef ELF_NAME4
+#undef ELF_PASTE4
+#undef ELF_SWAP
+#undef ELF_BITS
@@ -0,0 +1,276 @@
+#include "nm.h"
+
+/*
+** Worker pool (-j N)
+**
+** Description:
+**   Tasks (input files, or members of an archive) are handed out to N
+**   worker threads in order. Each worker runs its task with stdout and
+**   stderr captured in memory; the calling thread replays the captures in
+**   task order as soon as the next one is ready, each message at its
+**   place among the listing lines, so the output is byte-identical to a
+**   sequential run, stderr included.
+**
+** Why:
+**   Build-verification jobs call ft_nm on hundreds of objects at once, and
+**   static libraries hold thousands of members. Mapping, parsing,
+**   classifying and sorting are independent per task, only the printing
+**   has to be serialized.
+*/
+
+typedef struct s_job {
+	t_out	out;
+	t_out	err;
+	int		ret;
+	bool	done;
+}	t_job;
+
+typedef struct s_pool {
+	t_job			*jobs;
+	int				count;
+	int				next;
+	int				printed;
+	int				window;
+	t_task			task;
+	void			*ctx;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+}	t_pool;
+
+/*
+** worker
+**
+** Description:
+**   Claims the next unprocessed task and runs it with output captured.
+**   A worker never runs more than `window` tasks ahead of the printer, so
+**   captured output that is waiting to be printed stays bounded. Each
+**   worker has an arena of its own.
+*/
+static void *worker(void *arg)
+{
+	t_pool	*pool = arg;
+	t_job	*job;
+	t_arena	arena;
+	int		i;
+
+	arena_init(&arena);
+	arena_use(&arena);
+	while (1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while (pool->next < pool->count && pool->next >= pool->printed + pool->window)
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		if (pool->next >= pool->count)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			arena_use(NULL);
+			arena_free(&arena);
+			return NULL;
+		}
+		i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		job = &pool->jobs[i];
+		out_capture(&job->out, &job->err);
+		job->ret = pool->task(pool->ctx, i);
+		out_capture(NULL, NULL);
+
+		pthread_mutex_lock(&pool->lock);
+		job->done = true;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+static int replay_chunk(void *ctx, int fd, const char *s, size_t n)
+{
+	(void)ctx;
+	if (fd == 1)
+		out_write(out_stdout(), s, n);
+	else
+		out_err(s, n);
+	return 0;
+}
+
+/*
+** replay_job
+**
+** Description:
+**   Prints a finished job's captured stdout and stderr, interleaved the
+**   way a sequential run prints them (see out_replay).
+*/
+static void replay_job(t_job *job)
+{
+	out_replay(&job->out, &job->err, replay_chunk, NULL);
+	out_free_memory(&job->out);
+	out_free_memory(&job->err);
+}
+
+/*
+** run_jobs
+**
+** Description:
+**   Runs task(ctx, 0) .. task(ctx, count - 1) on `nthreads` workers and
+**   prints their output in index order. Returns non-zero if any task failed.
+*/
+int run_jobs(int count, int nthreads, t_task task, void *ctx)
+{
+	t_pool		pool;
+	pthread_t	*threads;
+	int			started = 0;
+	int			status = 0;
+
+	if (nthreads > count)
+		nthreads = count;
+	pool.jobs = calloc(count, sizeof(t_job));
+	threads = malloc(sizeof(pthread_t) * nthreads);
+	if (!pool.jobs || !threads)
+	{
+		free(pool.jobs);
+		free(threads);
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return 1;
+	}
+	pool.count = count;
+	pool.next = 0;
+	pool.printed = 0;
+	pool.window = nthreads * 4;
+	pool.task = task;
+	pool.ctx = ctx;
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+	for (int i = 0; i < count; i++)
+	{
+		out_init_memory(&pool.jobs[i].out);
+		out_init_memory(&pool.jobs[i].err);
+	}
+
+	for (int i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[started], NULL, worker, &pool) == 0)
+			started++;
+	// no thread could be started: run everything here, uncaptured
+	if (started == 0)
+	{
+		for (int i = 0; i < count; i++)
+			if (task(ctx, i) != 0)
+				status = 1;
+		pool.count = 0;
+	}
+
+	for (int i = 0; i < pool.count; i++)
+	{
+		pthread_mutex_lock(&pool.lock);
+		while (!pool.jobs[i].done)
+			pthread_cond_wait(&pool.cond, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+
+		replay_job(&pool.jobs[i]);
+		if (pool.jobs[i].ret != 0)
+			status = 1;
+
+		pthread_mutex_lock(&pool.lock);
+		pool.printed = i + 1;
+		pthread_cond_broadcast(&pool.cond);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&pool.lock);
+	pthread_cond_destroy(&pool.cond);
+	free(threads);
+	free(pool.jobs);
+	return status;
+}
+
+/*
+** Split work
+**
+** Description:
+**   One input too large for a single core is cut into `parts` contiguous
+**   pieces that run_split hands to as many threads, the calling thread
+**   taking part 0. Parts must neither print nor use the arena: the helper
+**   threads have none.
+**
+** Why:
+**   -j spreads files and archive members over cores, which does nothing
+**   for a single executable with millions of symbols.
+*/
+
+typedef struct s_split_arg {
+	t_split	fn;
+	void	*ctx;
+	int		part;
+	int		parts;
+}	t_split_arg;
+
+static void *split_thread(void *arg)
+{
+	t_split_arg *a = arg;
+
+	a->fn(a->ctx, a->part, a->parts);
+	return NULL;
+}
+
+/*
+** split_count
+**
+** Description:
+**   How many parts `n` items of one input are cut into: one per SPLIT_MIN
+**   items, at most -j, the number of online CPUs and SPLIT_MAX. Inside a
+**   -j worker the other workers already keep the cores busy, so nothing
+**   is split.
+*/
+int split_count(size_t n, t_nm_flags flags)
+{
+	size_t	parts = n / SPLIT_MIN;
+	long	cpus;
+
+	if (flags.jobs <= 1 || out_capture_err() || parts < 2)
+		return 1;
+	if (parts > (size_t)flags.jobs)
+		parts = flags.jobs;
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 0 && parts > (size_t)cpus)
+		parts = cpus;
+	if (parts < 2)
+		return 1;
+	if (parts > SPLIT_MAX)
+		parts = SPLIT_MAX;
+	return parts;
+}
+
+/*
+** run_split
+**
+** Description:
+**   Runs fn(ctx, 0, parts) .. fn(ctx, parts - 1, parts) in parallel and
+**   waits for all of them. A part whose thread cannot be started runs on
+**   the calling thread.
+*/
+void run_split(int parts, t_split fn, void *ctx)
+{
+	pthread_t	threads[SPLIT_MAX];
+	t_split_arg	args[SPLIT_MAX];
+	bool		started[SPLIT_MAX];
+
+	for (int i = 1; i < parts; i++)
+	{
+		args[i] = (t_split_arg){fn, ctx, i, parts};
+		started[i] = pthread_create(&threads[i], NULL, split_thread, &args[i]) == 0;
+	}
+	fn(ctx, 0, parts);
+	for (int i = 1; i < parts; i++)
+	{
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			fn(ctx, i, parts);
+	}
+}
+
+// first item of part `part` when `n` items are cut into `parts`
+size_t split_bound(size_t n, int part, int parts)
+{
+	return n * part / parts;
+}
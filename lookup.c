@@ -0,0 +1,212 @@
+#include "nm.h"
+
+/*
+** Symbol lookup (--lookup NAME[,NAME...])
+**
+** Description:
+**   Prints only the listing lines of the requested names, in the order
+**   they were asked for. Dynamic symbols (-D) are found through the
+**   object's own hash table, .gnu.hash (bloom filter first) or .hash;
+**   anything else costs a single pass over the symbol table. Nothing is
+**   sorted. Names that are not found are reported on stderr and make the
+**   exit status non-zero.
+**
+** Why:
+**   "Does this binary define X, and where?" used to mean extracting,
+**   sorting and printing the whole table only to grep one line out of it.
+**   The table walk itself lives in handle_elf.h (lookup_symtab).
+*/
+
+/*
+** lookup_parse
+**
+** Description:
+**   Splits the comma separated argument of --lookup in place. Returns -1
+**   on an empty name or a failed allocation.
+*/
+int lookup_parse(char *list, t_nm_flags *flags)
+{
+	int		tokens = 1;
+	int		count = 0;
+	char	**names;
+	char	*name;
+
+	for (int i = 0; list[i]; i++)
+		if (list[i] == ',')
+			tokens++;
+	names = malloc(sizeof(char *) * tokens);
+	if (!names)
+		return -1;
+	while (tokens-- > 0)
+	{
+		name = list;
+		while (*list && *list != ',')
+			list++;
+		if (*list)
+			*list++ = '\0';
+		if (!*name)
+		{
+			free(names);
+			return -1;
+		}
+		// a repeated name would only be printed twice
+		names[count] = name;
+		for (int k = 0; k < count; k++)
+			if (strcmp(names[k], name) == 0)
+			{
+				count--;
+				break;
+			}
+		count++;
+	}
+	flags->lookup = names;
+	flags->nlookup = count;
+	return 0;
+}
+
+/*
+** lookup_name_match
+**
+** Description:
+**   Whether symbol `name` answers the request `req`: equal names, or a
+**   `name` that is `req` followed by a version suffix. Linked executables
+**   keep undefined .symtab names as "memcpy@GLIBC_2.14".
+*/
+bool lookup_name_match(const char *name, const char *req)
+{
+	while (*req && *name == *req)
+	{
+		name++;
+		req++;
+	}
+	return !*req && (!*name || *name == '@');
+}
+
+/*
+** gnu_hash
+**
+** Description:
+**   Hash function of .gnu.hash (Bernstein's h * 33 + c).
+*/
+uint32_t gnu_hash(const char *name)
+{
+	uint32_t h = 5381;
+
+	while (*name)
+		h = (h << 5) + h + (unsigned char)*name++;
+	return h;
+}
+
+/*
+** sysv_hash
+**
+** Description:
+**   Hash function of the SysV .hash section (ELF gABI).
+*/
+uint32_t sysv_hash(const char *name)
+{
+	uint32_t h = 0;
+	uint32_t g;
+
+	while (*name)
+	{
+		h = (h << 4) + (unsigned char)*name++;
+		g = h & 0xf0000000;
+		if (g)
+			h ^= g >> 24;
+		h &= ~g;
+	}
+	return h;
+}
+
+/*
+** lookup_init
+**
+** Description:
+**   Prepares an empty match list for one symbol table.
+*/
+int lookup_init(t_lookup *lk, t_nm_flags flags)
+{
+	lk->tab = NULL;
+	lk->req = NULL;
+	lk->count = 0;
+	lk->cap = 0;
+	lk->found = calloc(flags.nlookup, sizeof(bool));
+	return lk->found ? 0 : -1;
+}
+
+/*
+** lookup_push
+**
+** Description:
+**   Appends a shown match for requested name `req` and returns the entry
+**   to fill, or NULL if the list could not grow.
+*/
+t_sym *lookup_push(t_lookup *lk, int req)
+{
+	if (lk->count == lk->cap)
+	{
+		size_t	cap = lk->cap ? lk->cap * 2 : 16;
+		t_sym	*tab = realloc(lk->tab, sizeof(t_sym) * cap);
+		int		*reqs;
+
+		if (!tab)
+			return NULL;
+		lk->tab = tab;
+		reqs = realloc(lk->req, sizeof(int) * cap);
+		if (!reqs)
+			return NULL;
+		lk->req = reqs;
+		lk->cap = cap;
+	}
+	lk->req[lk->count] = req;
+	lk->found[req] = true;
+	return &lk->tab[lk->count++];
+}
+
+/*
+** lookup_print
+**
+** Description:
+**   Prints the matches grouped by requested name, in request order (within
+**   one name, in symbol table order), reports the names that were not found
+**   and releases the list. The matches are bucketed by request in one
+**   counting pass, so each is visited once. Returns 1 if a name was
+**   missing, -1 if memory ran out.
+*/
+int lookup_print(t_lookup *lk, t_nm_flags flags, int bits)
+{
+	size_t	*start = calloc(flags.nlookup + 1, sizeof(size_t));
+	size_t	*order = malloc(sizeof(size_t) * (lk->count + 1));
+	int		ret = 0;
+
+	if (!start || !order)
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		ret = -1;
+	}
+	for (size_t k = 0; ret == 0 && k < lk->count; k++)
+		start[lk->req[k] + 1]++;
+	for (int i = 0; ret == 0 && i < flags.nlookup; i++)
+		start[i + 1] += start[i];
+	// stable: the matches of a name stay in symbol table order
+	for (size_t k = 0; ret == 0 && k < lk->count; k++)
+		order[start[lk->req[k]]++] = k;
+	for (int i = 0; ret >= 0 && i < flags.nlookup; i++)
+	{
+		for (size_t k = i ? start[i - 1] : 0; k < start[i]; k++)
+			printTable(&lk->tab[order[k]], 1, flags, bits);
+		if (lk->found[i])
+			continue;
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, flags.lookup[i]);
+		ft_putstr_fd(2, "': symbol not found\n");
+		ret = 1;
+	}
+	free(start);
+	free(order);
+	free(lk->tab);
+	free(lk->req);
+	free(lk->found);
+	return ret;
+}
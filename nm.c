@@ -1,7 +1,91 @@
 #include "nm.h"
 
 /*
-** ft_nm
+** nm_buffer
+**
+** Description:
+**   Dispatches an in-memory object to the right handler: ELF64, ELF32 or
+**   an `ar` archive. `name` is only used in error messages. An object
+**   gets its -P header here, once it is known not to be an archive.
+**
+** Why:
+**   Archive members live at an offset inside the archive's mapping; they
+**   go through exactly the same checks as a standalone file without being
+**   copied.
+*/
+int nm_buffer(char *data, size_t size, char *name, t_nm_flags flags)
+{
+	if (size >= EI_NIDENT && data[EI_MAG0] == ELFMAG0 && data[EI_MAG1] == ELFMAG1
+		&& data[EI_MAG2] == ELFMAG2 && data[EI_MAG3] == ELFMAG3)
+	{
+		format_header(flags);
+		if (data[EI_CLASS] == ELFCLASS64)
+			return handle64(data, (Elf64_Ehdr *)data, size, flags);
+		else if (data[EI_CLASS] == ELFCLASS32)
+			return handle32(data, (Elf32_Ehdr *)data, size, flags);
+		return 0;
+	}
+	if (is_archive(data, size) && flags.diff)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, name);
+		ft_putstr_fd(2, "': '--diff' compares objects, not archives\n");
+		return 1;
+	}
+	if (is_archive(data, size))
+		return handle_archive(data, size, flags);
+
+	ft_putstr_fd(2, "ft_nm: '");
+	ft_putstr_fd(2, name);
+	ft_putstr_fd(2, "': File format not recognized\n");
+	return 1;
+}
+
+/*
+** ft_nm_parse
+**
+** Description:
+**   Lists a file that has to be read: through --stream's sparse image, or
+**   by mapping it whole.
+*/
+static int ft_nm_parse(int fd, char *filename, size_t size, t_nm_flags flags)
+{
+	char *data;
+	int ret;
+
+	stats_phase(STATS_OTHER);
+	if (flags.stream)
+	{
+		ret = stream_file(fd, filename, size, flags);
+		if (ret != STREAM_FALLBACK)
+			return ret;
+	}
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, filename);
+		ft_putstr_fd(2, "': Unable to map file\n");
+		return 1;
+	}
+	stats_phase(STATS_MAP);
+	stats_add(STATS_MAPPED, size);
+	ret = nm_buffer(data, size, filename, flags);
+
+	stats_phase(STATS_OTHER);
+	if (munmap(data, size) < 0)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, filename);
+		ft_putstr_fd(2, "': Unable to unmap file\n");
+		return 1;
+	}
+	return ret;
+}
+
+/*
+** ft_nm_cached
 **
 ** Description:
 **   This is the core function of the nm program. It handles file checking,
@@ -11,10 +95,20 @@
 **   We need to verify if the file is valid, not a directory, and map it into memory
 **   for efficient access. Checking the ELF magic numbers allows us to determine
 **   if it's a valid ELF file and which architecture to use.
+**   With --cache-dir, an index of the unchanged file is printed instead
+**   (see cache.c), and a missing one is written while parsing. Inside
+**   --serve the same indexes are kept in the server's memory (serve.c).
+**   Indexes hold no sizes, so -S, --size-sort, --resolve, --diff and the
+**   formats other than BSD always parse the file. Archives are not cached
+**   either (see handle_archive), so their magic is read before any key is
+**   computed.
 */
-int ft_nm(int fd, char *filename, t_nm_flags flags) {
+static int ft_nm_cached(int fd, char *filename, t_nm_flags flags)
+{
 	struct stat file_info;
-	char *data;
+	t_cache cache;
+	char magic[AR_MAGIC_LEN];
+	int ret;
 
 	if (fstat(fd, &file_info) < 0 || S_ISDIR(file_info.st_mode))
 	{
@@ -24,38 +118,192 @@ int ft_nm(int fd, char *filename, t_nm_flags flags) {
 		return 1;
 	}
 
-	data = mmap(NULL, file_info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-	if (data == MAP_FAILED)
+	flags.cache = NULL;
+	if ((flags.cache_dir || flags.served) && !flags.nlookup && !flags.xref
+		&& !flags.print_size && !flags.size_sort && !flags.resolve && !flags.diff && flags.format == FORMAT_BSD
+		&& !(pread(fd, magic, AR_MAGIC_LEN, 0) == AR_MAGIC_LEN && is_archive(magic, AR_MAGIC_LEN))
+		&& cache_open(&cache, flags.served ? NULL : flags.cache_dir, &file_info, flags) == 0)
 	{
-		ft_putstr_fd(2, "ft_nm: '");
-		ft_putstr_fd(2, filename);
-		ft_putstr_fd(2, "': Unable to map file\n");
-		return 1;
+		if ((flags.served ? serve_cache_print(&cache, flags) : cache_print(&cache, flags)) == 0)
+		{
+			stats_phase(STATS_PRINT);
+			cache_close(&cache);
+			return 0;
+		}
+		flags.cache = &cache;
+	}
+	ret = ft_nm_parse(fd, filename, file_info.st_size, flags);
+	if (flags.cache)
+	{
+		if (flags.served && ret == 0)
+			serve_cache_insert(&cache);
+		cache_close(&cache);
 	}
+	return ret;
+}
 
+/*
+** ft_nm
+**
+** Description:
+**   Lists an open file, accounting for it with --stats (see stats.c), then
+**   resets the thread's arena for the next file (see arena.c).
+*/
+int ft_nm(int fd, char *filename, t_nm_flags flags)
+{
+	t_stats st;
+	int ret;
 
-	if (data[EI_MAG0] == ELFMAG0 && data[EI_MAG1] == ELFMAG1 && data[EI_MAG2] == ELFMAG2 && data[EI_MAG3] == ELFMAG3)
+	if (flags.stats)
+		stats_begin(&st, filename);
+	flags.file_name = filename;
+	ret = ft_nm_cached(fd, filename, flags);
+	if (flags.stats)
+		stats_end(&st, flags);
+	arena_reset();
+	return ret;
+}
+
+/*
+** remove_arg
+**
+** Description:
+**   Removes argv[i] from the argument list, shifting the rest down.
+*/
+static void remove_arg(int *argc, char ***argv, int i)
+{
+	for (int k = i; k < *argc - 1; k++)
+		(*argv)[k] = (*argv)[k + 1];
+	(*argc)--;
+}
+
+/*
+** long_value
+**
+** Description:
+**   If argv[i] is the long option `name`, returns its value, either glued
+**   (--name=value) or taken from the next argument, which is then removed.
+**   Returns false if argv[i] is another option; `*value` is NULL when the
+**   value is missing.
+*/
+static bool long_value(int *argc, char ***argv, int i, const char *name, char **value)
+{
+	size_t len = ft_strlen(name);
+	char *arg = (*argv)[i];
+
+	if (ft_strncmp(arg, name, len) != 0 || (arg[len] != '=' && arg[len] != '\0'))
+		return false;
+	*value = arg[len] == '=' ? &arg[len + 1] : NULL;
+	if (!*value && i + 1 < *argc)
 	{
-		if (data[EI_CLASS] == ELFCLASS64)
-			return handle64(data, (Elf64_Ehdr *)data, file_info, flags);
-		else if (data[EI_CLASS] == ELFCLASS32)
-			return handle32(data, (Elf32_Ehdr *)data, file_info, flags);
+		*value = (*argv)[i + 1];
+		remove_arg(argc, argv, i + 1);
 	}
-	else
+	return true;
+}
+
+/*
+** parse_size
+**
+** Description:
+**   Parses a byte count with an optional K, M or G suffix.
+*/
+static int parse_size(const char *s, size_t *size)
+{
+	size_t n = 0;
+
+	if (!s || *s < '0' || *s > '9')
+		return -1;
+	while (*s >= '0' && *s <= '9')
 	{
-		ft_putstr_fd(2, "ft_nm: '");
-		ft_putstr_fd(2, filename);
-		ft_putstr_fd(2, "': File format not recognized\n");
-		return 1;
+		if (n > ((size_t)1 << 40))
+			return -1;
+		n = n * 10 + (*s++ - '0');
 	}
+	if (*s == 'K' || *s == 'k')
+		n <<= 10;
+	else if (*s == 'M' || *s == 'm')
+		n <<= 20;
+	else if (*s == 'G' || *s == 'g')
+		n <<= 30;
+	if (*s && *++s)
+		return -1;
+	*size = n;
+	return 0;
+}
 
-	if (munmap(data, file_info.st_size) < 0)
+/*
+** set_order
+**
+** Description:
+**   Selects one of -p, -n and --size-sort: like binutils, the last one
+**   given wins.
+*/
+static void set_order(t_nm_flags *flags, int *order)
+{
+	flags->p = 0;
+	flags->numeric = 0;
+	flags->size_sort = 0;
+	*order = 1;
+}
+
+/*
+** parse_address
+**
+** Description:
+**   Parses the value of --start-address or --stop-address: hexadecimal
+**   with a 0x prefix, decimal otherwise.
+*/
+static int parse_address(const char *s, uint64_t *addr)
+{
+	uint64_t	n = 0;
+	uint64_t	base = 10;
+	uint64_t	d;
+
+	if (s && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
 	{
-		ft_putstr_fd(2, "ft_nm: '");
-		ft_putstr_fd(2, filename);
-		ft_putstr_fd(2, "': Unable to unmap file\n");
-		return 1;
+		base = 16;
+		s += 2;
 	}
+	if (!s || !*s)
+		return -1;
+	for (; *s; s++)
+	{
+		if (*s >= '0' && *s <= '9')
+			d = *s - '0';
+		else if (base == 16 && (*s | 32) >= 'a' && (*s | 32) <= 'f')
+			d = (*s | 32) - 'a' + 10;
+		else
+			return -1;
+		if (n > (UINT64_MAX - d) / base)
+			return -1;
+		n = n * base + d;
+	}
+	*addr = n;
+	return 0;
+}
+
+/*
+** parse_jobs
+**
+** Description:
+**   Parses the argument of -j: a strictly positive decimal number.
+*/
+static int parse_jobs(const char *s, t_nm_flags *flags)
+{
+	long n = 0;
+
+	if (!s || !*s)
+		return -1;
+	for (int i = 0; s[i]; i++)
+	{
+		if (s[i] < '0' || s[i] > '9' || n > 4096)
+			return -1;
+		n = n * 10 + (s[i] - '0');
+	}
+	if (n < 1 || n > 4096)
+		return -1;
+	flags->jobs = n;
 	return 0;
 }
 
@@ -65,7 +313,24 @@ int ft_nm(int fd, char *filename, t_nm_flags flags) {
 ** Description:
 **   Parses command-line arguments to set configuration flags for the nm program.
 **   Supported flags: -a (all), -g (extern only), -u (undefined only),
-**   -r (reverse sort), -p (no sort).
+**   -r (reverse sort), -p (no sort), -D (dynamic symbols),
+**   -S (print sizes, or --print-size), -n (by address, or --numeric-sort),
+**   -j N (process N files in parallel).
+**   Long options: --unbuffered (write byte by byte, for throughput comparisons),
+**   --stream (read only the sections that are needed, see stream.c),
+**   --lookup NAME[,NAME...] (print only those symbols, see lookup.c),
+**   --cache-dir DIR and --cache-max SIZE (symbol index cache, see cache.c),
+**   --serve SOCK (symbol server, see serve.c; --client is handled in main),
+**   --stats[=text|json] (per-phase report on stderr, see stats.c), which
+**   FT_NM_STATS=text|json turns on as well, --xref (cross-file definition
+**   and reference report instead of the listings, see xref.c),
+**   --size-sort (defined symbols with a size, by size, see sort.c),
+**   --start-address ADDR and --stop-address ADDR (only the defined symbols
+**   in [start, stop), see sort_range), --resolve[=FILE] (symbol+offset of
+**   each address read, see resolve.c), -P or --format FORMAT (bsd, posix,
+**   json or csv, see format.c), -C or --demangle (C++ names, see
+**   demangle.c), --diff (compare the symbols of the two files given, see
+**   diff.c).
 **
 ** Why:
 **   To support bonus features and standard nm behavior options. We extract flags
@@ -75,16 +340,159 @@ int parse_flags(int *argc, char ***argv, t_nm_flags *flags)
 {
 	int i = 1;
 	int j;
+	char *value;
 
 	flags->a = 0;
 	flags->g = 0;
 	flags->u = 0;
 	flags->r = 0;
 	flags->p = 0;
+	flags->jobs = 1;
+	flags->stream = 0;
+	flags->dynamic = 0;
+	flags->print_size = 0;
+	flags->size_sort = 0;
+	flags->numeric = 0;
+	flags->range = 0;
+	flags->start_address = 0;
+	flags->stop_address = UINT64_MAX;
+	flags->lookup = NULL;
+	flags->nlookup = 0;
+	flags->unbuffered = 0;
+	flags->cache_dir = NULL;
+	flags->cache_max = CACHE_DEFAULT_MAX;
+	flags->cache = NULL;
+	flags->serve = NULL;
+	flags->served = 0;
+	flags->dirfd = AT_FDCWD;
+	flags->stats = 0;
+	flags->stats_total = NULL;
+	flags->xref = 0;
+	flags->xref_table = NULL;
+	flags->xref_file = XREF_NONE;
+	flags->resolve = 0;
+	flags->resolve_input = NULL;
+	flags->format = FORMAT_BSD;
+	flags->demangle = 0;
+	flags->demangle_table = NULL;
+	flags->diff = 0;
+	flags->diff_table = NULL;
+	flags->file_name = NULL;
+	flags->member_name = NULL;
+	flags->print_fname = 0;
+	if (getenv("FT_NM_STATS") && *getenv("FT_NM_STATS"))
+		flags->stats = stats_mode(getenv("FT_NM_STATS"));
+	if (flags->stats < 0)
+	{
+		ft_putstr_fd(2, "ft_nm: invalid value for FT_NM_STATS\n");
+		return -1;
+	}
 
 	while (i < *argc)
 	{
-		if ((*argv)[i][0] == '-')
+		if ((*argv)[i][0] == '-' && (*argv)[i][1] == '-')
+		{
+			if (ft_strncmp((*argv)[i], "--unbuffered", 13) == 0)
+				flags->unbuffered = 1;
+			else if (ft_strncmp((*argv)[i], "--stream", 9) == 0)
+				flags->stream = 1;
+			else if (ft_strncmp((*argv)[i], "--dynamic", 10) == 0)
+				flags->dynamic = 1;
+			else if (ft_strncmp((*argv)[i], "--demangle", 11) == 0)
+				flags->demangle = 1;
+			else if (ft_strncmp((*argv)[i], "--diff", 7) == 0)
+				flags->diff = 1;
+			else if (ft_strncmp((*argv)[i], "--xref", 7) == 0)
+				flags->xref = 1;
+			else if (ft_strncmp((*argv)[i], "--size-sort", 12) == 0)
+				set_order(flags, &flags->size_sort);
+			else if (ft_strncmp((*argv)[i], "--print-size", 13) == 0)
+				flags->print_size = 1;
+			else if (ft_strncmp((*argv)[i], "--numeric-sort", 15) == 0)
+				set_order(flags, &flags->numeric);
+			else if (long_value(argc, argv, i, "--start-address", &value)
+				|| long_value(argc, argv, i, "--stop-address", &value))
+			{
+				flags->range = 1;
+				if (parse_address(value, (*argv)[i][4] == 'a' ? &flags->start_address
+					: &flags->stop_address) < 0)
+				{
+					ft_putstr_fd(2, "ft_nm: invalid address for '");
+					ft_putstr_fd(2, (*argv)[i]);
+					ft_putstr_fd(2, "'\n");
+					return -1;
+				}
+			}
+			// the value is optional, so it can only be glued
+			else if (ft_strncmp((*argv)[i], "--resolve", 10) == 0
+				|| ft_strncmp((*argv)[i], "--resolve=", 10) == 0)
+			{
+				flags->resolve = 1;
+				flags->resolve_input = (*argv)[i][9] ? &(*argv)[i][10] : NULL;
+			}
+			else if (ft_strncmp((*argv)[i], "--stats", 8) == 0
+				|| ft_strncmp((*argv)[i], "--stats=", 8) == 0)
+			{
+				flags->stats = stats_mode((*argv)[i][7] ? &(*argv)[i][8] : NULL);
+				if (flags->stats < 0)
+				{
+					ft_putstr_fd(2, "ft_nm: invalid format for '--stats'\n");
+					return -1;
+				}
+			}
+			else if (long_value(argc, argv, i, "--format", &value))
+			{
+				if ((flags->format = format_parse(value)) < 0)
+				{
+					ft_putstr_fd(2, "ft_nm: invalid format for '--format'\n");
+					return -1;
+				}
+			}
+			else if (long_value(argc, argv, i, "--lookup", &value))
+			{
+				free(flags->lookup);
+				if (!value || lookup_parse(value, flags) < 0)
+				{
+					ft_putstr_fd(2, "ft_nm: invalid symbol list for '--lookup'\n");
+					return -1;
+				}
+			}
+			else if (long_value(argc, argv, i, "--cache-dir", &value))
+			{
+				if (!value || !*value)
+				{
+					ft_putstr_fd(2, "ft_nm: missing directory for '--cache-dir'\n");
+					return -1;
+				}
+				flags->cache_dir = value;
+			}
+			else if (long_value(argc, argv, i, "--serve", &value))
+			{
+				if (!value || !*value)
+				{
+					ft_putstr_fd(2, "ft_nm: missing socket path for '--serve'\n");
+					return -1;
+				}
+				flags->serve = value;
+			}
+			else if (long_value(argc, argv, i, "--cache-max", &value))
+			{
+				if (parse_size(value, &flags->cache_max) < 0)
+				{
+					ft_putstr_fd(2, "ft_nm: invalid size for '--cache-max'\n");
+					return -1;
+				}
+			}
+			else
+			{
+				ft_putstr_fd(2, "ft_nm: unrecognized option '");
+				ft_putstr_fd(2, (*argv)[i]);
+				ft_putstr_fd(2, "'\n");
+				return -1;
+			}
+			remove_arg(argc, argv, i);
+		}
+		else if ((*argv)[i][0] == '-')
 		{
 			j = 1;
 			while ((*argv)[i][j])
@@ -93,20 +501,40 @@ int parse_flags(int *argc, char ***argv, t_nm_flags *flags)
 				else if ((*argv)[i][j] == 'g') flags->g = 1;
 				else if ((*argv)[i][j] == 'u') flags->u = 1;
 				else if ((*argv)[i][j] == 'r') flags->r = 1;
-				else if ((*argv)[i][j] == 'p') flags->p = 1;
+				else if ((*argv)[i][j] == 'p') set_order(flags, &flags->p);
+				else if ((*argv)[i][j] == 'D') flags->dynamic = 1;
+				else if ((*argv)[i][j] == 'S') flags->print_size = 1;
+				else if ((*argv)[i][j] == 'n') set_order(flags, &flags->numeric);
+				else if ((*argv)[i][j] == 'P') flags->format = FORMAT_POSIX;
+				else if ((*argv)[i][j] == 'C') flags->demangle = 1;
+				else if ((*argv)[i][j] == 'j')
+				{
+					// the count is either glued (-j8) or the next argument
+					value = &(*argv)[i][j + 1];
+					if (!*value && i + 1 < *argc)
+					{
+						value = (*argv)[i + 1];
+						remove_arg(argc, argv, i + 1);
+					}
+					if (parse_jobs(value, flags) < 0)
+					{
+						ft_putstr_fd(2, "ft_nm: invalid number of jobs '");
+						ft_putstr_fd(2, value);
+						ft_putstr_fd(2, "'\n");
+						return -1;
+					}
+					break;
+				}
 				else 
 				{
 					ft_putstr_fd(2, "ft_nm: invalid option -- '");
-					write(2, &(*argv)[i][j], 1);
+					out_err(&(*argv)[i][j], 1);
 					ft_putstr_fd(2, "'\n");
 					return -1;
 				}
 				j++;
 			}
-			// remove this arg
-			for (int k = i; k < *argc - 1; k++)
-				(*argv)[k] = (*argv)[k + 1];
-			(*argc)--;
+			remove_arg(argc, argv, i);
 		}
 		else
 		{
@@ -116,6 +544,78 @@ int parse_flags(int *argc, char ***argv, t_nm_flags *flags)
 	return 0;
 }
 
+/*
+** flags_no_output
+**
+** Description:
+**   Whether the flags can list nothing at all: -u with --size-sort, as
+**   undefined symbols have no size. binutils then warns and does not even
+**   open the inputs, so main and a --serve request stop there with status
+**   0. Prints the warning.
+*/
+bool flags_no_output(t_nm_flags flags)
+{
+	if (!flags.u || !flags.size_sort)
+		return false;
+	ft_putstr_fd(2, "ft_nm: Using the --size-sort and --undefined-only options together\n");
+	ft_putstr_fd(2, "ft_nm: will produce no output, since undefined symbols have no size.\n");
+	return true;
+}
+
+/*
+** nm_file
+**
+** Description:
+**   Opens one input file, prints its `\nfile:\n` header when several files
+**   are listed, runs ft_nm on it and closes it. Returns non-zero on failure.
+**   With --xref there is no listing, hence no header. The other formats
+**   have headers of their own, if any (see format.c).
+**
+** Why:
+**   Shared by the sequential loop and the -j workers so both produce the
+**   same output and error messages for a given file.
+*/
+int nm_file(char *filename, t_nm_flags flags, int print_fname)
+{
+	int fd;
+	int ret;
+
+	// relative names are resolved against the client's directory under --serve
+	fd = openat(flags.dirfd, filename, O_RDONLY);
+	if (fd == -1)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, filename);
+		ft_putstr_fd(2, "': No such file\n");
+		return 1;
+	}
+	flags.print_fname = print_fname;
+	if (print_fname && !flags.xref && flags.format == FORMAT_BSD)
+	{
+		ft_putstr_fd(1, "\n");
+		ft_putstr_fd(1, filename);
+		ft_putstr_fd(1, ":\n");
+	}
+	ret = ft_nm(fd, filename, flags);
+	close(fd);
+	return ret;
+}
+
+typedef struct s_file_list {
+	char		**names;
+	t_nm_flags	flags;
+	int			print_fname;
+}	t_file_list;
+
+static int file_task(void *ctx, int index)
+{
+	t_file_list *files = ctx;
+	t_nm_flags flags = files->flags;
+
+	flags.xref_file = index;
+	return nm_file(files->names[index], flags, files->print_fname);
+}
+
 /*
 ** main
 **
@@ -125,16 +625,70 @@ int parse_flags(int *argc, char ***argv, t_nm_flags *flags)
 ** Why:
 **   Standard C entry point. It orchestrates the flow: parse flags -> loop files
 **   -> call ft_nm for each. Defaulting to "a.out" if no file is provided is standard behavior.
+**   With -j the files are spread over a worker pool (see jobs.c); the exit
+**   status is non-zero if any file failed. --client hands the whole command
+**   line to a --serve process instead. With --xref the report comes once
+**   every file has been read. -C memoizes demangled names for the whole
+**   run. --diff compares its two files instead of listing them.
 */
 int main(int argc, char **argv) {
 	int fd;
-	int ret;
+	int ret = 0;
 	t_nm_flags flags;
+	t_stats total;
+	t_arena arena;
+	t_xref xref;
+	t_demangle demangle;
+	char *default_file = "a.out";
 
+	ret = client_main(argc, argv);
+	if (ret >= 0)
+		exit(ret);
+	ret = 0;
+	// names are sorted in the user's collation, like binutils nm
+	setlocale(LC_COLLATE, "");
 	if (parse_flags(&argc, &argv, &flags) < 0)
 		return 1;
+	// parse_flags has no side effects: --serve runs it on client command lines
+	if (flags.unbuffered)
+		out_set_unbuffered(true);
+	// an existing directory is fine, any other failure shows on first use
+	if (flags.cache_dir)
+		mkdir(flags.cache_dir, 0777);
+	if (flags_no_output(flags))
+		return 0;
+	if (flags.resolve && (argc > 2 || flags.xref || flags.nlookup))
+	{
+		ft_putstr_fd(2, "ft_nm: '--resolve' takes a single file and no '--xref' or '--lookup'\n");
+		return 1;
+	}
+	if (flags.serve)
+		exit(serve_main(flags.serve, flags));
+	memset(&total, 0, sizeof(total));
+	if (flags.stats)
+		flags.stats_total = &total;
+	arena_init(&arena);
+	arena_use(&arena);
+	format_begin(flags);
+	if (flags.demangle)
+	{
+		demangle_init(&demangle);
+		flags.demangle_table = &demangle;
+	}
+	if (flags.xref)
+	{
+		flags.xref_table = &xref;
+		if (xref_init(&xref, argc == 1 ? &default_file : argv + 1, argc == 1 ? 1 : argc - 1) < 0)
+		{
+			ft_putstr_fd(2, "Memory allocation failed\n");
+			exit(1);
+		}
+		flags.xref_file = 0;
+	}
 
-	if (argc == 1)
+	if (flags.diff)
+		ret = diff_main(argv + 1, argc - 1, flags);
+	else if (argc == 1)
 	{
 		fd = open("a.out", O_RDONLY);
 		if (fd == -1)
@@ -150,28 +704,37 @@ int main(int argc, char **argv) {
 		// if multiple files, print filename before output if not just one
 		int print_fname = (argc > 2);
 		
-		for (int i = 1; i < argc; i++)
+		if (flags.jobs > 1 && argc > 2)
 		{
-			fd = open(argv[i], O_RDONLY);
-			if (fd == -1)
-			{
-				ft_putstr_fd(2, "ft_nm: '");
-				ft_putstr_fd(2, argv[i]);
-				ft_putstr_fd(2, "': No such file\n");
-			}
-			else
+			t_file_list files = {argv + 1, flags, print_fname};
+			ret = run_jobs(argc - 1, flags.jobs, file_task, &files);
+		}
+		else
+		{
+			for (int i = 1; i < argc; i++)
 			{
-				if (print_fname)
-				{
-					ft_putstr_fd(1, "\n");
-					ft_putstr_fd(1, argv[i]);
-					ft_putstr_fd(1, ":\n");
-				}
-				ret = ft_nm(fd, argv[i], flags);
-				close(fd);
+				flags.xref_file = i - 1;
+				if (nm_file(argv[i], flags, print_fname) != 0)
+					ret = 1;
 			}
 		}
 	}
 
-	ret == 0 ? exit(0) : exit(1);
-}
\ No newline at end of file
+	if (flags.xref)
+	{
+		if (xref_report(&xref) < 0)
+		{
+			ft_putstr_fd(2, "Memory allocation failed\n");
+			ret = 1;
+		}
+		xref_free(&xref);
+	}
+	if (flags.demangle)
+		demangle_free(&demangle);
+	out_flush(out_stdout());
+	if (flags.stats)
+		stats_report_total(&total, flags);
+	arena_free(&arena);
+	// --diff: 1 when the tables differ, 2 on trouble, like diff(1)
+	exit(flags.diff || ret == 0 ? ret : 1);
+}
@@ -13,48 +13,453 @@
 #include <endian.h>
 #include <math.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <locale.h>
+#include <stddef.h>
+
+# define OUT_BUFSIZE (1 << 16)
+# define AR_MAGIC "!<arch>\n"
+# define AR_MAGIC_LEN 8
 
 
 typedef struct s_sym {
 	char *name;
 	uint64_t addr;
+	uint64_t size;
 	unsigned char letter;
 	unsigned short shndx;
-	int used;
+	char *version;
+	bool version_hidden;
+	unsigned char info;
+	const char *section;
 }	t_sym;
 
+# define SYMSET_SHSTRTAB 0x80000000u
+# define SYMSET_NULL_NAME 0xffffffffu
+# define SYMSET_EMPTY_NAME 0xfffffffeu
+// string tables must stay below this size for 32-bit name references
+# define SYMSET_MAX_STRTAB 0x7ffffffeu
+# define VERSION_HIDDEN 0x8000
+// size of an -a section symbol under --size-sort until symtab_section_sizes
+# define SYMSET_SECTION_SIZE UINT64_MAX
+
+typedef struct s_symset {
+	char		*strtab;
+	char		*shstrtab;
+	char		**vernames;
+	size_t		nvernames;
+	size_t		count;
+	uint32_t	*name;
+	uint64_t	*addr;
+	uint64_t	*size;
+	uint8_t		*letter;
+	uint16_t	*shndx;
+	uint16_t	*version;
+	uint8_t		*info;
+	char		**secnames;
+	size_t		nsecnames;
+	uint32_t	*order;
+	char		**coll;
+}	t_symset;
+
+typedef struct s_versions {
+	uint16_t	*versym;
+	char		**names;
+	size_t		count;
+	uint16_t	cverdefs;
+	bool		base_flag;
+}	t_versions;
+
+# define STREAM_MAX_RANGES 16
+# define STREAM_FALLBACK -2
+
+typedef struct s_stream {
+	int			fd;
+	char		*base;
+	size_t		size;
+	size_t		bytes_read;
+	uint64_t	ranges[STREAM_MAX_RANGES][2];
+	int			nranges;
+}	t_stream;
+
+typedef struct s_sort_key {
+	uint64_t prefix;
+	uint64_t addr;
+	uint32_t idx;
+}	t_sort_key;
+
+# define FORMAT_BSD 0
+# define FORMAT_POSIX 1
+# define FORMAT_JSON 2
+# define FORMAT_CSV 3
+
 typedef struct s_nm_flags {
 	int a;
 	int g;
 	int u;
 	int r;
 	int p;
+	int jobs;
+	int unbuffered;
+	int stream;
+	int dynamic;
+	int print_size;
+	int size_sort;
+	int numeric;
+	int range;
+	uint64_t start_address;
+	uint64_t stop_address;
+	char **lookup;
+	int nlookup;
+	char *cache_dir;
+	size_t cache_max;
+	struct s_cache *cache;
+	char *serve;
+	int served;
+	int dirfd;
+	int stats;
+	struct s_stats *stats_total;
+	int xref;
+	struct s_xref *xref_table;
+	uint32_t xref_file;
+	int resolve;
+	char *resolve_input;
+	int format;
+	int demangle;
+	struct s_demangle *demangle_table;
+	int diff;
+	struct s_diff *diff_table;
+	char *file_name;
+	char *member_name;
+	int print_fname;
 } t_nm_flags;
 
-int elf64_symbols(Elf64_Sym sym, Elf64_Shdr *shdr, char *file_data, Elf64_Ehdr *elf_header);
-int elf32_symbols(Elf32_Sym sym, Elf32_Shdr *shdr, char *file_data, Elf32_Ehdr *elf_header);
+# define STATS_TEXT 1
+# define STATS_JSON 2
+
+typedef enum e_phase {
+	STATS_MAP,
+	STATS_SCAN,
+	STATS_CLASSIFY,
+	STATS_SORT,
+	STATS_PRINT,
+	STATS_OTHER,
+	STATS_PHASES
+}	t_phase;
+
+typedef enum e_counter {
+	STATS_SCANNED,
+	STATS_KEPT,
+	STATS_PRINTED,
+	STATS_MAPPED,
+	STATS_TOUCHED,
+	STATS_COUNTERS
+}	t_counter;
+
+typedef struct s_stats {
+	const char	*name;
+	size_t		files;
+	uint64_t	ns[STATS_PHASES];
+	uint64_t	total_ns;
+	size_t		count[STATS_COUNTERS];
+	long		minflt;
+	long		majflt;
+	size_t		heap_sampled;
+	size_t		arena_peak;
+	size_t		out_bytes;
+	size_t		writes;
+	uint64_t	start;
+	uint64_t	mark;
+	size_t		out_start;
+	size_t		writes_start;
+}	t_stats;
+
+# define CACHE_DEFAULT_MAX ((size_t)256 << 20)
+
+typedef struct s_cache {
+	const char	*dir;
+	char		*path;
+	size_t		max;
+	uint64_t	dev;
+	uint64_t	ino;
+	uint64_t	size;
+	uint64_t	mtime_ns;
+	uint32_t	keyflags;
+	char		*blob;
+	size_t		blob_size;
+}	t_cache;
+
+typedef struct s_lookup {
+	t_sym	*tab;
+	int		*req;
+	size_t	count;
+	size_t	cap;
+	bool	*found;
+}	t_lookup;
+
+# define XREF_NONE 0xffffffffu
+
+typedef struct s_xref_file {
+	char		*name;
+	uint32_t	top;
+	uint32_t	member;
+}	t_xref_file;
+
+typedef struct s_strpool {
+	char	*next;
+	size_t	left;
+	char	*blocks;
+}	t_strpool;
+
+typedef struct s_strmap {
+	uint32_t	*slots;
+	size_t		nslots;
+	size_t		stride;
+	size_t		hash_off;
+	size_t		key_off;
+}	t_strmap;
+
+typedef struct s_xref_name {
+	char		*name;
+	uint32_t	hash;
+	uint32_t	def;
+	uint32_t	weak;
+	uint32_t	ref;
+	uint32_t	ndefs;
+	uint32_t	nrefs;
+	uint32_t	dups;
+}	t_xref_name;
+
+typedef struct s_xref_dup {
+	uint32_t	file;
+	uint32_t	next;
+}	t_xref_dup;
+
+typedef struct s_xref {
+	t_strmap		map;
+	t_xref_name		*names;
+	size_t			count;
+	size_t			cap;
+	t_xref_dup		*dups;
+	size_t			ndups;
+	size_t			dups_cap;
+	t_xref_file		*files;
+	size_t			nfiles;
+	size_t			files_cap;
+	t_strpool		pool;
+	pthread_mutex_t	lock;
+}	t_xref;
+
+typedef struct s_resolve {
+	uint64_t		*start;
+	uint64_t		*end;
+	uint32_t		*sym;
+	const char		**name;
+	size_t			count;
+	uint32_t		*guide;
+	size_t			nguide;
+	int				shift;
+}	t_resolve;
+
+# define DEMANGLE_SHARD_BITS 4
+# define DEMANGLE_SHARDS (1 << DEMANGLE_SHARD_BITS)
+
+typedef struct s_demangle_entry {
+	char		*mangled;
+	char		*plain;
+	uint32_t	hash;
+}	t_demangle_entry;
+
+typedef struct s_demangle_shard {
+	t_strmap			map;
+	t_demangle_entry	*entries;
+	size_t				count;
+	size_t				cap;
+	t_strpool			pool;
+	pthread_mutex_t		lock;
+}	t_demangle_shard;
 
-int handle64(char *file_data, Elf64_Ehdr *elf_header, struct stat fd_info, t_nm_flags flags);
-int handle32(char *file_data, Elf32_Ehdr *elf_header, struct stat fd_info, t_nm_flags flags);
+typedef struct s_demangle {
+	t_demangle_shard	shards[DEMANGLE_SHARDS];
+}	t_demangle;
+
+typedef struct s_diff_sym {
+	const char		*name;
+	const char		*version;
+	uint64_t		size;
+	unsigned char	letter;
+	bool			hidden;
+	bool			undef;
+}	t_diff_sym;
+
+typedef struct s_diff {
+	t_diff_sym	*old;
+	size_t		nold;
+	char		*strings;
+	bool		loaded;
+	bool		reported;
+	bool		changed;
+}	t_diff;
+
+# define ARENA_MIN_BLOCK ((size_t)1 << 16)
+
+typedef struct s_arena_block {
+	struct s_arena_block	*prev;
+	size_t					size;
+	size_t					used;
+}	t_arena_block;
+
+typedef struct s_arena {
+	t_arena_block	*block;
+	size_t			reserved;
+	size_t			used;
+	size_t			high;
+}	t_arena;
+
+typedef struct s_out {
+	int		fd;
+	char	*buf;
+	size_t	len;
+	size_t	cap;
+	size_t	flushed;
+	size_t	syscalls;
+}	t_out;
+
+int handle64(char *file_data, Elf64_Ehdr *elf_header, size_t file_size, t_nm_flags flags);
+int handle32(char *file_data, Elf32_Ehdr *elf_header, size_t file_size, t_nm_flags flags);
 
 void printTable(t_sym *tab, size_t tab_size, t_nm_flags flags, int bits);
+void printSet(const t_symset *set, t_nm_flags flags, int bits);
+bool sym_shown(unsigned char letter, uint16_t shndx, uint64_t addr, uint64_t size, t_nm_flags flags);
 bool str_is_nullterm(const char *start, const char *end);
 int	ft_strncmp(const char *first, const char *second, size_t length);
 void	ft_putstr_fd(int fd, char *s);
 void	print_hex(uint64_t nbr, int width);
+void	ft_putnbr_fd(int fd, uint64_t nbr);
 size_t	ft_strlen(const char *theString);
 
 
-void sort(t_sym *syms, int size, t_nm_flags flags);
-void mergeSort(t_sym *syms, int l, int r);
+t_out	*out_stdout(void);
+void	out_set_unbuffered(bool unbuffered);
+void	out_flush(t_out *out);
+void	out_write(t_out *out, const char *s, size_t n);
+void	out_putc(t_out *out, char c);
+void	out_str(t_out *out, const char *s);
+void	out_blank(t_out *out, int width);
+void	out_hex(t_out *out, uint64_t nbr, int width);
+typedef int (*t_emit)(void *ctx, int fd, const char *s, size_t n);
+
+void	out_capture(t_out *out, t_out *err);
+void	out_capture_limit(size_t limit, t_emit emit, void *ctx);
+void	out_err(const char *s, size_t n);
+int		out_replay(const t_out *out, const t_out *err, t_emit emit, void *ctx);
+t_out	*out_capture_err(void);
+void	out_init_memory(t_out *out);
+void	out_free_memory(t_out *out);
+size_t	out_tell(t_out *out);
+
+void	arena_init(t_arena *a);
+void	arena_use(t_arena *a);
+t_arena	*arena_current(void);
+void	*arena_alloc(size_t size);
+void	arena_reset(void);
+void	arena_free(t_arena *a);
+
+typedef int (*t_task)(void *ctx, int index);
+typedef void (*t_split)(void *ctx, int part, int parts);
+
+# define SPLIT_MIN ((size_t)1 << 16)
+# define SPLIT_MAX 64
+
+int nm_buffer(char *data, size_t size, char *name, t_nm_flags flags);
+int nm_file(char *filename, t_nm_flags flags, int print_fname);
+int parse_flags(int *argc, char ***argv, t_nm_flags *flags);
+bool flags_no_output(t_nm_flags flags);
+int run_jobs(int count, int nthreads, t_task task, void *ctx);
+int split_count(size_t n, t_nm_flags flags);
+void run_split(int parts, t_split fn, void *ctx);
+size_t split_bound(size_t n, int part, int parts);
+
+int stream_load(t_stream *st, uint64_t offset, uint64_t len);
+int stream_file(int fd, char *filename, size_t size, t_nm_flags flags);
+int elf64_stream_sections(t_stream *st, t_nm_flags flags);
+int elf32_stream_sections(t_stream *st, t_nm_flags flags);
+
+int lookup_parse(char *list, t_nm_flags *flags);
+bool lookup_name_match(const char *name, const char *req);
+uint32_t gnu_hash(const char *name);
+uint32_t sysv_hash(const char *name);
+int lookup_init(t_lookup *lk, t_nm_flags flags);
+t_sym *lookup_push(t_lookup *lk, int req);
+int lookup_print(t_lookup *lk, t_nm_flags flags, int bits);
+
+int cache_open(t_cache *c, const char *dir, struct stat *st, t_nm_flags flags);
+int cache_print(t_cache *c, t_nm_flags flags);
+int cache_print_index(t_cache *c, char *data, size_t size, t_nm_flags flags);
+void cache_store(t_cache *c, const t_symset *set, int bits);
+void cache_close(t_cache *c);
+
+int serve_main(const char *path, t_nm_flags flags);
+int serve_cache_print(t_cache *c, t_nm_flags flags);
+void serve_cache_insert(t_cache *c);
+int client_main(int argc, char **argv);
+
+int stats_mode(const char *value);
+t_stats *stats_current(void);
+void stats_begin(t_stats *st, const char *name);
+void stats_phase(t_phase phase);
+void stats_add(t_counter counter, size_t n);
+void stats_join(t_stats *st, t_stats *parent);
+void stats_end(t_stats *st, t_nm_flags flags);
+void stats_report_total(t_stats *total, t_nm_flags flags);
+
+char *strpool_dup(t_strpool *p, const char *s, size_t len);
+void strpool_free(t_strpool *p);
+void strmap_init(t_strmap *m, size_t stride, size_t hash_off, size_t key_off);
+int strmap_reserve(t_strmap *m, const void *records, size_t count);
+size_t strmap_find(const t_strmap *m, const void *records, const char *key, uint32_t hash);
+void strmap_free(t_strmap *m);
+
+int xref_init(t_xref *x, char **names, int count);
+uint32_t xref_member(t_xref *x, uint32_t parent, int index, const char *name);
+int xref_add(t_xref *x, const t_symset *set, uint32_t file);
+int xref_report(t_xref *x);
+void xref_free(t_xref *x);
+
+int format_parse(const char *value);
+void format_begin(t_nm_flags flags);
+void format_header(t_nm_flags flags);
+void format_line(t_out *out, const t_sym *row, t_nm_flags flags);
+
+void demangle_init(t_demangle *d);
+const char *demangle_name(t_demangle *d, const char *name);
+void demangle_free(t_demangle *d);
+
+int diff_add(t_diff *d, t_symset *set, t_nm_flags flags);
+int diff_main(char **files, int count, t_nm_flags flags);
+
+int resolve_main(t_symset *set, const uint64_t *sec_end, size_t nsec, t_nm_flags flags);
+
+bool is_archive(const char *data, size_t size);
+int handle_archive(char *data, size_t size, t_nm_flags flags);
+
+
+int symset_alloc(t_symset *set, size_t count, bool versions, bool sizes, bool infos);
+char *symset_name_at(char *strtab, char *shstrtab, uint32_t ref);
+char *symset_name(const t_symset *set, size_t i);
+char *version_name(char **names, size_t count, uint16_t code);
+char *section_name(char **names, size_t count, uint16_t shndx);
+void symset_row(const t_symset *set, size_t i, t_sym *row);
+size_t symset_at(const t_symset *set, size_t k);
+void symset_move(t_symset *set, size_t dst, size_t src, size_t n);
 
+uint32_t sort_collation(void);
+int sort(t_symset *set, t_nm_flags flags);
+void sort_range(const t_symset *set, t_nm_flags flags, size_t *lo, size_t *hi);
 
-uint64_t read_uint64(uint64_t nb, char *file);
-uint32_t read_uint32(uint32_t nb, char *file);
-uint16_t read_uint16(uint16_t nb, char *file);
 
-int check_endian(char *file);
 bool need_change_endian(char *file);
-void reverse_endian(void *ptr, size_t length);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,358 @@
+#include "nm.h"
+
+/*
+** Output layer
+**
+** Description:
+**   Every byte that ft_nm prints to stdout goes through a single user-space
+**   buffer which is only handed to write(2) once it is full (or at exit).
+**   Symbol names that do not fit in what is left of the buffer are written
+**   with writev(2) straight from the mapped string table, together with the
+**   pending bytes, so they are never copied twice.
+**
+** Why:
+**   The original implementation issued one write(2) per character, which on
+**   large binaries means tens of millions of syscalls. The per-byte path is
+**   kept behind `--unbuffered` so both can be timed against each other.
+*/
+
+static char		g_stdout_buf[OUT_BUFSIZE];
+static t_out	g_stdout = {1, g_stdout_buf, 0, OUT_BUFSIZE, 0, 0};
+static bool		g_unbuffered = false;
+
+static __thread t_out	*g_capture_out = NULL;
+static __thread t_out	*g_capture_err = NULL;
+static __thread size_t	g_capture_limit = 0;
+static __thread t_emit	g_capture_emit = NULL;
+static __thread void	*g_capture_ctx = NULL;
+
+static const char g_hex_pairs[513] =
+	"000102030405060708090a0b0c0d0e0f"
+	"101112131415161718191a1b1c1d1e1f"
+	"202122232425262728292a2b2c2d2e2f"
+	"303132333435363738393a3b3c3d3e3f"
+	"404142434445464748494a4b4c4d4e4f"
+	"505152535455565758595a5b5c5d5e5f"
+	"606162636465666768696a6b6c6d6e6f"
+	"707172737475767778797a7b7c7d7e7f"
+	"808182838485868788898a8b8c8d8e8f"
+	"909192939495969798999a9b9c9d9e9f"
+	"a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+	"b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+	"c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+	"d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+	"e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+	"f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+static const char g_blanks[] = "                ";
+
+t_out *out_stdout(void)
+{
+	return g_capture_out ? g_capture_out : &g_stdout;
+}
+
+/*
+** out_capture
+**
+** Description:
+**   Redirects what the calling thread prints to stdout and stderr into the
+**   two in-memory buffers `out` and `err` (created with out_init_memory).
+**   Passing NULL restores the real file descriptors.
+**
+** Why:
+**   Worker threads (-j) process files out of order; their output is
+**   captured and replayed by the main thread in command-line order.
+**   Stderr goes through out_err, which records where each message falls
+**   among the captured stdout bytes, so that out_replay restores the
+**   interleaving of a sequential run.
+*/
+void out_capture(t_out *out, t_out *err)
+{
+	g_capture_out = out;
+	g_capture_err = err;
+}
+
+t_out *out_capture_err(void)
+{
+	return g_capture_err;
+}
+
+/*
+** out_capture_limit
+**
+** Description:
+**   Caps the calling thread's capture at about `limit` bytes per stream:
+**   past it, what the capture holds is handed to `emit` (see out_replay)
+**   and dropped. A NULL `emit` lifts the cap.
+*/
+void out_capture_limit(size_t limit, t_emit emit, void *ctx)
+{
+	g_capture_limit = limit;
+	g_capture_emit = emit;
+	g_capture_ctx = ctx;
+}
+
+// empties a capture past its limit; if `emit` fails, that output is lost
+static void out_spill(void)
+{
+	out_replay(g_capture_out, g_capture_err, g_capture_emit, g_capture_ctx);
+	g_capture_out->len = 0;
+	g_capture_err->len = 0;
+}
+
+void out_init_memory(t_out *out)
+{
+	out->fd = -1;
+	out->buf = NULL;
+	out->len = 0;
+	out->cap = 0;
+	out->flushed = 0;
+	out->syscalls = 0;
+}
+
+void out_free_memory(t_out *out)
+{
+	free(out->buf);
+	out_init_memory(out);
+}
+
+/*
+** out_grow
+**
+** Description:
+**   Makes room for `n` more bytes in an in-memory buffer, doubling its
+**   capacity. Returns false if the allocation failed.
+*/
+static bool out_grow(t_out *out, size_t n)
+{
+	size_t	cap = out->cap ? out->cap : OUT_BUFSIZE;
+	char	*buf;
+
+	while (cap < out->len + n)
+		cap *= 2;
+	buf = realloc(out->buf, cap);
+	if (!buf)
+		return false;
+	out->buf = buf;
+	out->cap = cap;
+	return true;
+}
+
+/*
+** out_err
+**
+** Description:
+**   Writes `n` bytes to stderr, flushing the stdout buffer first so that
+**   messages keep their place among the listing lines. Inside a capture
+**   the bytes go to the stderr buffer behind a mark: the number of stdout
+**   bytes captured before them, and their length.
+*/
+void out_err(const char *s, size_t n)
+{
+	t_out	*err = g_capture_err;
+	size_t	mark[2];
+
+	if (!err)
+	{
+		out_flush(out_stdout());
+		write(2, s, n);
+		return;
+	}
+	if (g_capture_emit && err->len && err->len + sizeof(mark) + n > g_capture_limit)
+		out_spill();
+	if (err->len + sizeof(mark) + n > err->cap && !out_grow(err, sizeof(mark) + n))
+		return;
+	mark[0] = g_capture_out ? g_capture_out->len : 0;
+	mark[1] = n;
+	memcpy(err->buf + err->len, mark, sizeof(mark));
+	memcpy(err->buf + err->len + sizeof(mark), s, n);
+	err->len += sizeof(mark) + n;
+}
+
+/*
+** out_replay
+**
+** Description:
+**   Hands the contents of a capture to `emit` in the order they were
+**   printed, as chunks of stdout (fd 1) and stderr (fd 2). Returns -1 as
+**   soon as `emit` fails.
+*/
+int out_replay(const t_out *out, const t_out *err, t_emit emit, void *ctx)
+{
+	size_t	pos = 0;
+	size_t	at = 0;
+	size_t	mark[2];
+
+	while (at + sizeof(mark) <= err->len)
+	{
+		memcpy(mark, err->buf + at, sizeof(mark));
+		at += sizeof(mark);
+		if (mark[0] > pos && emit(ctx, 1, out->buf + pos, mark[0] - pos) < 0)
+			return -1;
+		pos = mark[0] > pos ? mark[0] : pos;
+		if (emit(ctx, 2, err->buf + at, mark[1]) < 0)
+			return -1;
+		at += mark[1];
+	}
+	if (out->len > pos && emit(ctx, 1, out->buf + pos, out->len - pos) < 0)
+		return -1;
+	return 0;
+}
+
+void out_set_unbuffered(bool unbuffered)
+{
+	g_unbuffered = unbuffered;
+}
+
+/*
+** out_tell
+**
+** Description:
+**   Number of bytes printed to `out` so far, flushed or still buffered.
+*/
+size_t out_tell(t_out *out)
+{
+	return out->flushed + out->len;
+}
+
+/*
+** write_all
+**
+** Description:
+**   Loops on write(2) until the whole range is written or an error occurs.
+*/
+static void write_all(t_out *out, const char *s, size_t n)
+{
+	ssize_t ret;
+
+	while (n > 0)
+	{
+		out->syscalls++;
+		ret = write(out->fd, s, n);
+		if (ret < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		s += ret;
+		n -= ret;
+	}
+}
+
+void out_flush(t_out *out)
+{
+	if (out->len == 0 || out->fd < 0)
+		return;
+	write_all(out, out->buf, out->len);
+	out->flushed += out->len;
+	out->len = 0;
+}
+
+/*
+** out_write
+**
+** Description:
+**   Appends `n` bytes to the buffer. When they do not fit, the pending
+**   buffer and the new bytes are sent together with a single writev(2).
+*/
+void out_write(t_out *out, const char *s, size_t n)
+{
+	struct iovec	iov[2];
+	ssize_t			ret;
+
+	if (out->fd < 0)
+	{
+		if (g_capture_emit && out == g_capture_out && out->len && out->len + n > g_capture_limit)
+			out_spill();
+		if (out->len + n > out->cap && !out_grow(out, n))
+			return;
+		memcpy(out->buf + out->len, s, n);
+		out->len += n;
+		return;
+	}
+	if (g_unbuffered)
+	{
+		for (size_t i = 0; i < n; i++)
+			write(out->fd, &s[i], 1);
+		out->flushed += n;
+		out->syscalls += n;
+		return;
+	}
+	if (out->len + n <= out->cap)
+	{
+		memcpy(out->buf + out->len, s, n);
+		out->len += n;
+		return;
+	}
+	iov[0].iov_base = out->buf;
+	iov[0].iov_len = out->len;
+	iov[1].iov_base = (void *)s;
+	iov[1].iov_len = n;
+	out->syscalls++;
+	ret = writev(out->fd, iov, 2);
+	if (ret < 0 || (size_t)ret < out->len + n)
+	{
+		// short write: fall back to plain writes for whatever is left
+		size_t done = ret < 0 ? 0 : (size_t)ret;
+		if (done < out->len)
+		{
+			write_all(out, out->buf + done, out->len - done);
+			write_all(out, s, n);
+		}
+		else
+			write_all(out, s + (done - out->len), n - (done - out->len));
+	}
+	out->flushed += out->len + n;
+	out->len = 0;
+}
+
+void out_putc(t_out *out, char c)
+{
+	if ((!g_unbuffered || out->fd < 0) && out->len < out->cap)
+		out->buf[out->len++] = c;
+	else
+		out_write(out, &c, 1);
+}
+
+void out_str(t_out *out, const char *s)
+{
+	out_write(out, s, ft_strlen(s));
+}
+
+/*
+** out_blank
+**
+** Description:
+**   Emits `width` spaces (at most 16), used in place of the address column
+**   of undefined symbols.
+*/
+void out_blank(t_out *out, int width)
+{
+	out_write(out, g_blanks, width);
+}
+
+/*
+** out_hex
+**
+** Description:
+**   Formats `nbr` as zero-padded lowercase hexadecimal of exactly `width`
+**   digits (8 or 16), one byte at a time through a 256-entry pair table.
+**   Values wider than `width` are printed in full, like print_hex did.
+*/
+void out_hex(t_out *out, uint64_t nbr, int width)
+{
+	char	tmp[16];
+	int		digits = 16;
+	int		i = 16;
+
+	while (digits > width && !(nbr >> ((digits - 1) * 4)))
+		digits--;
+	while (i > 0)
+	{
+		i -= 2;
+		memcpy(tmp + i, g_hex_pairs + (nbr & 0xff) * 2, 2);
+		nbr >>= 8;
+	}
+	out_write(out, tmp + 16 - digits, digits);
+}
@@ -0,0 +1,411 @@
+#include "nm.h"
+
+/*
+** Address resolution (--resolve)
+**
+** Description:
+**   Reads addresses from stdin, or from FILE with --resolve=FILE, one per
+**   line in hexadecimal with or without 0x, and prints one line for each:
+**   `symbol+0xoffset`, or `??` when no symbol covers the address or the
+**   line holds none. Only the first word of a line is read, so perf-style
+**   dumps can be fed as they are.
+**
+**   The defined symbols of the listing become an index of disjoint
+**   intervals sorted by start, one per distinct address. Among symbols
+**   sharing an address, one with a size wins, then a global one, then
+**   the first by name. An interval ends at start + st_size, or for a
+**   symbol without size at the end of its section, and never after the
+**   next start.
+**
+** Why:
+**   Symbolizing millions of samples by grepping listings costs a scan per
+**   address. Here the index is built once, and a lookup reads a guide
+**   table indexed by the address's high bits, then runs a branchless
+**   binary search over the few starts of that bucket: a couple of cache
+**   misses instead of one per level in a large index. A batch of
+**   addresses that comes in ascending order is merged with the index
+**   instead: each search gallops forward from the previous answer.
+*/
+
+#define RESOLVE_BATCH 4096
+#define RESOLVE_NONE 0xffffffffu
+
+/*
+** resolve_better
+**
+** Description:
+**   Whether symbol `a` should own an address rather than symbol `b`.
+*/
+static bool resolve_better(const t_symset *set, size_t a, size_t b)
+{
+	bool	sized_a = set->size[a] != 0;
+	bool	sized_b = set->size[b] != 0;
+
+	if (sized_a != sized_b)
+		return sized_a;
+	return (set->letter[a] >= 'A' && set->letter[a] <= 'Z')
+		&& !(set->letter[b] >= 'A' && set->letter[b] <= 'Z');
+}
+
+/*
+** resolve_guide
+**
+** Description:
+**   Cuts the span of the starts into at most `count` buckets of 2^shift
+**   addresses; guide[b] is the position of the first start in bucket b
+**   or after it, guide[nguide] the number of starts. Returns -1 if memory
+**   ran out.
+*/
+static int resolve_guide(t_resolve *r)
+{
+	uint64_t	span;
+	size_t		b = 0;
+
+	r->shift = 0;
+	r->nguide = 0;
+	if (r->count == 0)
+		return 0;
+	span = r->start[r->count - 1] - r->start[0];
+	while ((span >> r->shift) >= r->count)
+		r->shift++;
+	r->nguide = (span >> r->shift) + 1;
+	if (!(r->guide = arena_alloc(sizeof(uint32_t) * (r->nguide + 1))))
+		return -1;
+	for (size_t k = 0; k < r->count; k++)
+		while (b <= ((r->start[k] - r->start[0]) >> r->shift))
+			r->guide[b++] = k;
+	while (b <= r->nguide)
+		r->guide[b++] = r->count;
+	return 0;
+}
+
+/*
+** resolve_build
+**
+** Description:
+**   Builds the interval index of a set (see the top of this file) in the
+**   arena. `sec_end[s]` is the end address of section s, for the `nsec`
+**   sections of the file. Returns -1 if memory ran out.
+*/
+static int resolve_build(t_resolve *r, t_symset *set, const uint64_t *sec_end, size_t nsec,
+	t_nm_flags flags)
+{
+	size_t		n = 0;
+	size_t		i;
+	uint64_t	end;
+
+	flags.numeric = 1;
+	flags.size_sort = 0;
+	flags.p = 0;
+	flags.r = 0;
+	r->start = arena_alloc(sizeof(uint64_t) * set->count);
+	r->end = arena_alloc(sizeof(uint64_t) * set->count);
+	r->sym = arena_alloc(sizeof(uint32_t) * set->count);
+	r->name = arena_alloc(sizeof(char *) * set->count);
+	if (!r->start || !r->end || !r->sym || !r->name || sort(set, flags) < 0)
+		return -1;
+	for (size_t k = 0; k < set->count; k++)
+	{
+		i = symset_at(set, k);
+		if (set->shndx[i] == SHN_UNDEF || set->shndx[i] == SHN_ABS || set->shndx[i] == SHN_COMMON)
+			continue;
+		if (n && r->start[n - 1] == set->addr[i])
+		{
+			if (resolve_better(set, i, r->sym[n - 1]))
+				r->sym[n - 1] = i;
+			continue;
+		}
+		r->start[n] = set->addr[i];
+		r->sym[n++] = i;
+	}
+	for (size_t k = 0; k < n; k++)
+	{
+		i = r->sym[k];
+		if (set->size[i])
+			end = r->start[k] + set->size[i] < r->start[k] ? UINT64_MAX : r->start[k] + set->size[i];
+		else
+			end = set->shndx[i] < nsec ? sec_end[set->shndx[i]] : UINT64_MAX;
+		if (k + 1 < n && end > r->start[k + 1])
+			end = r->start[k + 1];
+		r->end[k] = end;
+		r->name[k] = symset_name(set, i);
+	}
+	r->count = n;
+	return resolve_guide(r);
+}
+
+/*
+** resolve_search
+**
+** Description:
+**   Position of the last of the `n` sorted starts that is <= `addr`, or 0.
+**   The loop has no data-dependent branch: the halving step compiles to
+**   a conditional move, so mispredictions cost nothing.
+*/
+static inline size_t resolve_search(const uint64_t *start, size_t n, uint64_t addr)
+{
+	const uint64_t	*base = start;
+	size_t			half;
+
+	while (n > 1)
+	{
+		half = n / 2;
+		base = (base[half] <= addr) ? base + half : base;
+		n -= half;
+	}
+	return base - start;
+}
+
+/*
+** resolve_find
+**
+** Description:
+**   Position of the last start <= `addr`, or 0, through the guide: the
+**   answer lies between the last start before the address's bucket and
+**   the last start inside it.
+*/
+static inline size_t resolve_find(const t_resolve *r, uint64_t addr)
+{
+	uint64_t	b;
+	size_t		lo;
+
+	if (addr <= r->start[0])
+		return 0;
+	b = (addr - r->start[0]) >> r->shift;
+	if (b >= r->nguide)
+		return r->count - 1;
+	lo = r->guide[b] ? r->guide[b] - 1 : 0;
+	return lo + resolve_search(r->start + lo, r->guide[b + 1] - lo, addr);
+}
+
+/*
+** resolve_batch
+**
+** Description:
+**   Resolves `count` addresses into interval positions (RESOLVE_NONE when
+**   none covers the address). An ascending batch is merged with the index:
+**   each search starts where the previous one ended, galloping forward
+**   before the binary search.
+*/
+static void resolve_batch(const t_resolve *r, const uint64_t *addr, const bool *valid,
+	uint32_t *hit, size_t count, bool sorted)
+{
+	size_t	k = 0;
+	size_t	step;
+
+	for (size_t q = 0; q < count; q++)
+	{
+		hit[q] = RESOLVE_NONE;
+		if (!valid[q] || r->count == 0)
+			continue;
+		if (sorted)
+		{
+			step = 1;
+			while (k + step < r->count && r->start[k + step] <= addr[q])
+			{
+				k += step;
+				step *= 2;
+			}
+			k += resolve_search(r->start + k, (r->count - k < step) ? r->count - k : step, addr[q]);
+		}
+		else
+			k = resolve_find(r, addr[q]);
+		if (r->start[k] <= addr[q] && addr[q] < r->end[k])
+			hit[q] = k;
+	}
+}
+
+/*
+** resolve_parse
+**
+** Description:
+**   Reads the address at the start of a line (leading blanks skipped).
+**   Returns false if the first word is not a hexadecimal number.
+*/
+static bool resolve_parse(const char *s, const char *eol, uint64_t *addr)
+{
+	uint64_t	n = 0;
+	int			digits = 0;
+	int			d;
+
+	while (s < eol && (*s == ' ' || *s == '\t'))
+		s++;
+	if (eol - s >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+		s += 2;
+	for (; s < eol && *s != ' ' && *s != '\t' && *s != '\r'; s++)
+	{
+		if (*s >= '0' && *s <= '9')
+			d = *s - '0';
+		else if ((*s | 32) >= 'a' && (*s | 32) <= 'f')
+			d = (*s | 32) - 'a' + 10;
+		else
+			return false;
+		if (++digits > 16)
+			return false;
+		n = (n << 4) | d;
+	}
+	*addr = n;
+	return digits > 0;
+}
+
+static void resolve_print(t_out *out, const t_resolve *r, uint64_t addr, uint32_t hit)
+{
+	char		tmp[16];
+	int			i = 16;
+	uint64_t	off;
+
+	if (hit == RESOLVE_NONE)
+	{
+		out_write(out, "??\n", 3);
+		return;
+	}
+	off = addr - r->start[hit];
+	out_str(out, r->name[hit]);
+	out_write(out, "+0x", 3);
+	do
+		tmp[--i] = "0123456789abcdef"[off & 15];
+	while (off >>= 4);
+	out_write(out, tmp + i, 16 - i);
+	out_putc(out, '\n');
+}
+
+typedef struct s_resolve_batch {
+	uint64_t	addr[RESOLVE_BATCH];
+	bool		valid[RESOLVE_BATCH];
+	uint32_t	hit[RESOLVE_BATCH];
+	size_t		count;
+	uint64_t	last;
+	bool		sorted;
+}	t_resolve_batch;
+
+static void resolve_flush(const t_resolve *r, t_resolve_batch *b)
+{
+	t_out *out = out_stdout();
+
+	resolve_batch(r, b->addr, b->valid, b->hit, b->count, b->sorted);
+	for (size_t q = 0; q < b->count; q++)
+		resolve_print(out, r, b->addr[q], b->hit[q]);
+	b->count = 0;
+	b->last = 0;
+	b->sorted = true;
+}
+
+static void resolve_line(const t_resolve *r, t_resolve_batch *b, const char *s, const char *eol)
+{
+	size_t q = b->count;
+
+	b->valid[q] = resolve_parse(s, eol, &b->addr[q]);
+	if (b->valid[q])
+	{
+		b->sorted &= b->addr[q] >= b->last;
+		b->last = b->addr[q];
+	}
+	if (++b->count == RESOLVE_BATCH)
+		resolve_flush(r, b);
+}
+
+/*
+** resolve_skip
+**
+** Description:
+**   Drops the rest of a line that did not fit in the read buffer, and
+**   moves what follows it to the start of the buffer. Returns how many
+**   bytes that is, 0 at the end of the input or -1 on a read error.
+*/
+static ssize_t resolve_skip(int fd, char *buf, size_t size)
+{
+	ssize_t	got;
+	char	*nl;
+
+	while ((got = read(fd, buf, size)) > 0)
+	{
+		if ((nl = memchr(buf, '\n', got)))
+		{
+			memmove(buf, nl + 1, buf + got - (nl + 1));
+			return buf + got - (nl + 1);
+		}
+	}
+	return got;
+}
+
+/*
+** resolve_stream
+**
+** Description:
+**   Feeds every line of `fd` to the batches. Of a line longer than the
+**   read buffer, only the start is looked at. Returns -1 on a read error.
+*/
+static int resolve_stream(const t_resolve *r, int fd, t_resolve_batch *b)
+{
+	char	buf[1 << 16];
+	size_t	len = 0;
+	ssize_t	got;
+	char	*s;
+	char	*eol;
+
+	while (1)
+	{
+		s = buf;
+		while ((eol = memchr(s, '\n', buf + len - s)))
+		{
+			resolve_line(r, b, s, eol);
+			s = eol + 1;
+		}
+		len = buf + len - s;
+		if (len == sizeof(buf))
+		{
+			resolve_line(r, b, buf, buf + len);
+			if ((got = resolve_skip(fd, buf, sizeof(buf))) < 0)
+				break;
+			len = got;
+			continue;
+		}
+		memmove(buf, s, len);
+		if ((got = read(fd, buf + len, sizeof(buf) - len)) <= 0)
+			break;
+		len += got;
+	}
+	if (len && got >= 0)
+		resolve_line(r, b, buf, buf + len);
+	resolve_flush(r, b);
+	return got < 0 ? -1 : 0;
+}
+
+/*
+** resolve_main
+**
+** Description:
+**   Builds the index of a set and answers the whole address stream.
+**   Returns non-zero on failure, after printing why.
+*/
+int resolve_main(t_symset *set, const uint64_t *sec_end, size_t nsec, t_nm_flags flags)
+{
+	t_resolve		r;
+	t_resolve_batch	*b;
+	int				fd = 0;
+	int				ret;
+
+	if (resolve_build(&r, set, sec_end, nsec, flags) < 0 || !(b = malloc(sizeof(*b))))
+	{
+		ft_putstr_fd(2, "Memory allocation failed\n");
+		return 1;
+	}
+	if (flags.resolve_input && (fd = openat(flags.dirfd, flags.resolve_input, O_RDONLY)) < 0)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, flags.resolve_input);
+		ft_putstr_fd(2, "': No such file\n");
+		free(b);
+		return 1;
+	}
+	b->count = 0;
+	b->last = 0;
+	b->sorted = true;
+	ret = resolve_stream(&r, fd, b);
+	if (ret < 0)
+		ft_putstr_fd(2, "ft_nm: error reading the addresses\n");
+	if (fd != 0)
+		close(fd);
+	free(b);
+	return ret < 0 ? 1 : 0;
+}
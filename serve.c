@@ -0,0 +1,674 @@
+// struct ucred needs _GNU_SOURCE, defined before any header
+#define _GNU_SOURCE
+#include "nm.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+
+/*
+** Symbol server (--serve SOCK) and thin client (--client SOCK)
+**
+** Description:
+**   The server listens on a Unix socket and runs each client's command
+**   line exactly like a local ft_nm would, one thread per client. Symbol
+**   lists it has already built are kept in memory as cache.c indexes, in
+**   an LRU keyed like the on-disk cache (dev, inode, size, mtime_ns and
+**   the listing flags), under the --cache-max byte budget. A file that
+**   changed gets a new key and is parsed again; its old entry ages out.
+**
+**   The client sends its working directory and arguments, then copies
+**   what comes back to its own stdout and stderr and exits with the
+**   server's status, so the output is the same as a local run.
+**
+**   The socket is created with mode 0600 and a client whose uid is not
+**   the server's is disconnected: a client reads any file the server can.
+**   Options acting on the whole server (--cache-dir, --unbuffered) are
+**   refused. A request holds at most SERVE_CAPTURE_MAX bytes of output in
+**   memory; past that, what it printed is sent on the fly.
+**
+**   Protocol (host byte order, the socket is local):
+**     request:  u32 count, then `count` times { u32 len, bytes }; the
+**               first string is the client's working directory, the
+**               others are its arguments without --client.
+**     response: frames { u8 type, u32 len, bytes }; type 1 is stdout,
+**               2 is stderr, 0 ends the reply and `len` is the status.
+**
+** Why:
+**   Symbolization and audit scripts start ft_nm thousands of times per
+**   hour on the same files; process startup, mapping and a full parse
+**   and sort are paid every time.
+*/
+
+#define SERVE_BUCKETS 1024
+#define SERVE_MAX_ARGS 4096
+#define SERVE_MAX_ARG_LEN (1 << 20)
+// output a request may hold in memory before it is sent
+#define SERVE_CAPTURE_MAX ((size_t)1 << 20)
+#define FRAME_EXIT 0
+#define FRAME_STDOUT 1
+#define FRAME_STDERR 2
+
+typedef struct s_entry {
+	uint64_t		dev;
+	uint64_t		ino;
+	uint64_t		size;
+	uint64_t		mtime_ns;
+	uint32_t		keyflags;
+	char			*blob;
+	size_t			blob_size;
+	size_t			bucket;
+	int				refs;
+	bool			evicted;
+	struct s_entry	*prev;
+	struct s_entry	*next;
+	struct s_entry	*hnext;
+}	t_entry;
+
+typedef struct s_lru {
+	pthread_mutex_t	lock;
+	t_entry			*buckets[SERVE_BUCKETS];
+	t_entry			*head;
+	t_entry			*tail;
+	size_t			bytes;
+	size_t			max;
+}	t_lru;
+
+static t_lru g_lru = {PTHREAD_MUTEX_INITIALIZER, {NULL}, NULL, NULL, 0, 0};
+
+static size_t lru_bucket(t_cache *c)
+{
+	uint64_t h = c->dev * 0x9e3779b97f4a7c15ULL;
+
+	h ^= c->ino + (h << 6) + (h >> 2);
+	h ^= c->mtime_ns + (h << 6) + (h >> 2);
+	h ^= c->keyflags + (h << 6) + (h >> 2);
+	return h % SERVE_BUCKETS;
+}
+
+static bool lru_same(t_entry *e, t_cache *c)
+{
+	return e->dev == c->dev && e->ino == c->ino && e->size == c->size
+		&& e->mtime_ns == c->mtime_ns && e->keyflags == c->keyflags;
+}
+
+static void lru_unlink(t_entry *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		g_lru.head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		g_lru.tail = e->prev;
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+static void lru_push_front(t_entry *e)
+{
+	e->next = g_lru.head;
+	e->prev = NULL;
+	if (g_lru.head)
+		g_lru.head->prev = e;
+	g_lru.head = e;
+	if (!g_lru.tail)
+		g_lru.tail = e;
+}
+
+static void lru_release(t_entry *e)
+{
+	free(e->blob);
+	free(e);
+}
+
+/*
+** lru_evict
+**
+** Description:
+**   Drops the least recently used entries until the cache fits its
+**   budget. An entry still being printed is freed by its last reader.
+**   Called with the lock held.
+*/
+static void lru_evict(void)
+{
+	t_entry		*e;
+	t_entry		**link;
+
+	while (g_lru.bytes > g_lru.max && g_lru.tail)
+	{
+		e = g_lru.tail;
+		lru_unlink(e);
+		for (link = &g_lru.buckets[e->bucket]; *link != e; link = &(*link)->hnext)
+			;
+		*link = e->hnext;
+		g_lru.bytes -= e->blob_size;
+		e->evicted = true;
+		if (e->refs == 0)
+			lru_release(e);
+	}
+}
+
+/*
+** serve_cache_print
+**
+** Description:
+**   Prints the listing of the file keyed by `c` if the server has it.
+**   Returns 0 on a hit and -1 when the file has to be parsed.
+*/
+int serve_cache_print(t_cache *c, t_nm_flags flags)
+{
+	t_entry	*e;
+	int		ret;
+
+	pthread_mutex_lock(&g_lru.lock);
+	for (e = g_lru.buckets[lru_bucket(c)]; e && !lru_same(e, c); e = e->hnext)
+		;
+	if (e)
+	{
+		e->refs++;
+		lru_unlink(e);
+		lru_push_front(e);
+	}
+	pthread_mutex_unlock(&g_lru.lock);
+	if (!e)
+		return -1;
+	// printing happens outside the lock, other clients keep going
+	ret = cache_print_index(c, e->blob, e->blob_size, flags);
+	pthread_mutex_lock(&g_lru.lock);
+	if (--e->refs == 0 && e->evicted)
+		lru_release(e);
+	pthread_mutex_unlock(&g_lru.lock);
+	return ret;
+}
+
+/*
+** serve_cache_insert
+**
+** Description:
+**   Takes over the in-memory index that parsing `c` produced, unless
+**   another client inserted the same file meanwhile or it alone exceeds
+**   the budget.
+*/
+void serve_cache_insert(t_cache *c)
+{
+	t_entry	*e;
+	size_t	b;
+
+	if (!c->blob || c->blob_size > g_lru.max)
+		return;
+	pthread_mutex_lock(&g_lru.lock);
+	b = lru_bucket(c);
+	for (e = g_lru.buckets[b]; e && !lru_same(e, c); e = e->hnext)
+		;
+	if (!e && (e = calloc(1, sizeof(t_entry))))
+	{
+		e->dev = c->dev;
+		e->ino = c->ino;
+		e->size = c->size;
+		e->mtime_ns = c->mtime_ns;
+		e->keyflags = c->keyflags;
+		e->blob = c->blob;
+		e->blob_size = c->blob_size;
+		e->bucket = b;
+		c->blob = NULL;
+		e->hnext = g_lru.buckets[b];
+		g_lru.buckets[b] = e;
+		lru_push_front(e);
+		g_lru.bytes += e->blob_size;
+		lru_evict();
+	}
+	pthread_mutex_unlock(&g_lru.lock);
+}
+
+/*
+** fd_read_all / fd_write_all
+**
+** Description:
+**   Loop until exactly `n` bytes are transferred. Return -1 on error or
+**   end of stream. Socket writes never raise SIGPIPE.
+*/
+static int fd_read_all(int fd, void *buf, size_t n)
+{
+	ssize_t ret;
+
+	while (n > 0)
+	{
+		ret = read(fd, buf, n);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf = (char *)buf + ret;
+		n -= ret;
+	}
+	return 0;
+}
+
+static int fd_write_all(int fd, const void *buf, size_t n, bool sock)
+{
+	ssize_t ret;
+
+	while (n > 0)
+	{
+		ret = sock ? send(fd, buf, n, MSG_NOSIGNAL) : write(fd, buf, n);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf = (const char *)buf + ret;
+		n -= ret;
+	}
+	return 0;
+}
+
+static int send_frame(int fd, uint8_t type, const char *data, uint32_t len)
+{
+	char hdr[5];
+
+	hdr[0] = type;
+	memcpy(hdr + 1, &len, 4);
+	if (fd_write_all(fd, hdr, 5, true) < 0)
+		return -1;
+	return (type == FRAME_EXIT) ? 0 : fd_write_all(fd, data, len, true);
+}
+
+// one stdout or stderr chunk of a capture, in frames of at most 1 GiB
+static int send_chunk(void *ctx, int stream, const char *s, size_t n)
+{
+	int		fd = *(int *)ctx;
+	size_t	chunk;
+
+	for (size_t done = 0; done < n; done += chunk)
+	{
+		chunk = n - done;
+		if (chunk > (1u << 30))
+			chunk = 1u << 30;
+		if (send_frame(fd, stream == 1 ? FRAME_STDOUT : FRAME_STDERR, s + done, chunk) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+** send_captured
+**
+** Description:
+**   Sends what a request printed so far, stdout and stderr interleaved as
+**   they were printed (see out_replay), and empties both buffers.
+*/
+static int send_captured(int fd, t_out *out, t_out *err)
+{
+	int ret = out_replay(out, err, send_chunk, &fd);
+
+	out->len = 0;
+	err->len = 0;
+	return ret;
+}
+
+/*
+** read_request
+**
+** Description:
+**   Reads a request into a NULL-terminated array of strings.
+*/
+static char **read_request(int fd, int *count)
+{
+	uint32_t	n;
+	uint32_t	len;
+	char		**strs;
+
+	if (fd_read_all(fd, &n, 4) < 0 || n == 0 || n > SERVE_MAX_ARGS)
+		return NULL;
+	strs = calloc(n + 1, sizeof(char *));
+	if (!strs)
+		return NULL;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		if (fd_read_all(fd, &len, 4) < 0 || len > SERVE_MAX_ARG_LEN
+			|| !(strs[i] = malloc(len + 1)) || fd_read_all(fd, strs[i], len) < 0)
+		{
+			for (uint32_t k = 0; k <= i; k++)
+				free(strs[k]);
+			free(strs);
+			return NULL;
+		}
+		strs[i][len] = '\0';
+	}
+	*count = n;
+	return strs;
+}
+
+/*
+** serve_request
+**
+** Description:
+**   Runs one client command line with its output captured, and sends it
+**   back file by file. argv[0] is the client's working directory, against
+**   which relative file names are opened. Returns the exit status.
+*/
+static int serve_request(int fd, int argc, char **argv, t_out *out, t_out *err)
+{
+	t_nm_flags	flags;
+	t_stats		total;
+	t_xref		xref;
+	t_demangle	demangle;
+	char		*default_file = "a.out";
+	int			ret = 0;
+
+	flags.lookup = NULL;
+	if (parse_flags(&argc, &argv, &flags) < 0)
+		ret = 1;
+	else if (flags.serve)
+	{
+		ft_putstr_fd(2, "ft_nm: '--serve' cannot be sent to a server\n");
+		ret = 1;
+	}
+	else if (flags.cache_dir || flags.unbuffered)
+	{
+		// both would act on the whole server, not on this request
+		ft_putstr_fd(2, "ft_nm: '--cache-dir' and '--unbuffered' cannot be sent to a server\n");
+		ret = 1;
+	}
+	else if (flags.resolve)
+	{
+		// the addresses would have to be read from the client's stdin
+		ft_putstr_fd(2, "ft_nm: '--resolve' cannot be sent to a server\n");
+		ret = 1;
+	}
+	else if (flags_no_output(flags))
+		ret = 0;
+	else if ((flags.dirfd = open(argv[0], O_RDONLY | O_DIRECTORY)) < 0)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, argv[0]);
+		ft_putstr_fd(2, "': Unable to open working directory\n");
+		ret = 1;
+	}
+	else
+	{
+		flags.jobs = 1;
+		flags.served = 1;
+		memset(&total, 0, sizeof(total));
+		if (flags.stats)
+			flags.stats_total = &total;
+		flags.xref_table = &xref;
+		flags.xref_file = 0;
+		if (flags.xref && xref_init(&xref, argc == 1 ? &default_file : argv + 1, argc == 1 ? 1 : argc - 1) < 0)
+		{
+			ft_putstr_fd(2, "Memory allocation failed\n");
+			// nothing is listed, the table is released below
+			argc = 0;
+			ret = 1;
+		}
+		format_begin(flags);
+		demangle_init(&demangle);
+		flags.demangle_table = &demangle;
+		if (flags.diff)
+			ret = diff_main(argv + 1, argc - 1, flags);
+		else if (argc == 1)
+			ret = nm_file("a.out", flags, 0);
+		for (int i = 1; i < argc && !flags.diff && send_captured(fd, out, err) == 0; i++)
+		{
+			flags.xref_file = i - 1;
+			if (nm_file(argv[i], flags, argc > 2) != 0)
+				ret = 1;
+		}
+		if (flags.xref)
+		{
+			if (argc && xref_report(&xref) < 0)
+			{
+				ft_putstr_fd(2, "Memory allocation failed\n");
+				ret = 1;
+			}
+			xref_free(&xref);
+		}
+		demangle_free(&demangle);
+		if (flags.stats)
+			stats_report_total(&total, flags);
+		close(flags.dirfd);
+	}
+	free(flags.lookup);
+	return ret;
+}
+
+/*
+** serve_client
+**
+** Description:
+**   Thread of one connection: answers requests until the client closes it.
+*/
+static void *serve_client(void *arg)
+{
+	int		fd = (int)(intptr_t)arg;
+	t_out	out;
+	t_out	err;
+	char	**strs;
+	int		count;
+	int		ret;
+	t_arena	arena;
+
+	out_init_memory(&out);
+	out_init_memory(&err);
+	arena_init(&arena);
+	arena_use(&arena);
+	while ((strs = read_request(fd, &count)))
+	{
+		// parse_flags shifts argv, so hand it a copy of the pointer array
+		char **argv = malloc(sizeof(char *) * (count + 1));
+		if (argv)
+		{
+			memcpy(argv, strs, sizeof(char *) * (count + 1));
+			out_capture(&out, &err);
+			out_capture_limit(SERVE_CAPTURE_MAX, send_chunk, &fd);
+			ret = serve_request(fd, count, argv, &out, &err);
+			out_capture_limit(0, NULL, NULL);
+			out_capture(NULL, NULL);
+		}
+		else
+			ret = 1;
+		free(argv);
+		for (int i = 0; i < count; i++)
+			free(strs[i]);
+		free(strs);
+		if (send_captured(fd, &out, &err) < 0 || send_frame(fd, FRAME_EXIT, NULL, ret) < 0)
+			break;
+	}
+	out_free_memory(&out);
+	out_free_memory(&err);
+	arena_use(NULL);
+	arena_free(&arena);
+	close(fd);
+	return NULL;
+}
+
+static int socket_address(const char *path, struct sockaddr_un *addr)
+{
+	if (ft_strlen(path) >= sizeof(addr->sun_path))
+		return -1;
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	memcpy(addr->sun_path, path, ft_strlen(path) + 1);
+	return 0;
+}
+
+/*
+** peer_allowed
+**
+** Description:
+**   Whether the process at the other end of `fd` runs as the server's
+**   user (SO_PEERCRED).
+*/
+static bool peer_allowed(int fd)
+{
+	struct ucred	cred;
+	socklen_t		len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+		return false;
+	return cred.uid == geteuid();
+}
+
+/*
+** serve_main
+**
+** Description:
+**   --serve: binds `path` (replacing a stale socket), then accepts
+**   clients of the same user forever, each on its own detached thread.
+*/
+int serve_main(const char *path, t_nm_flags flags)
+{
+	struct sockaddr_un	addr;
+	struct stat			st;
+	pthread_attr_t		attr;
+	pthread_t			thread;
+	int					sock;
+	int					fd;
+	int					ret;
+	mode_t				mask;
+
+	g_lru.max = flags.cache_max;
+	signal(SIGPIPE, SIG_IGN);
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 || socket_address(path, &addr) < 0)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, (char *)path);
+		ft_putstr_fd(2, "': Unable to create socket\n");
+		return 1;
+	}
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+	// the socket file is created 0600, with no window where others may connect
+	mask = umask(0177);
+	ret = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (ret < 0 || listen(sock, 64) < 0)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, (char *)path);
+		ft_putstr_fd(2, "': Unable to listen\n");
+		close(sock);
+		return 1;
+	}
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	while (1)
+	{
+		fd = accept(sock, NULL, NULL);
+		if (fd < 0)
+			continue;
+		if (!peer_allowed(fd) || pthread_create(&thread, &attr, serve_client, (void *)(intptr_t)fd) != 0)
+			close(fd);
+	}
+}
+
+/*
+** client_socket
+**
+** Description:
+**   Finds --client SOCK (or --client=SOCK) in argv and removes it.
+**   Returns NULL when the option is absent.
+*/
+static char *client_socket(int *argc, char **argv)
+{
+	char	*path = NULL;
+	int		skip = 0;
+
+	for (int i = 1; i < *argc && !path; i++)
+	{
+		if (ft_strncmp(argv[i], "--client=", 9) == 0)
+		{
+			path = argv[i] + 9;
+			skip = 1;
+		}
+		else if (ft_strncmp(argv[i], "--client", 9) == 0 && i + 1 < *argc)
+		{
+			path = argv[i + 1];
+			skip = 2;
+		}
+		if (path)
+		{
+			for (int k = i; k + skip < *argc; k++)
+				argv[k] = argv[k + skip];
+			*argc -= skip;
+		}
+	}
+	return path;
+}
+
+static int client_send_str(int fd, const char *s)
+{
+	uint32_t len = ft_strlen(s);
+
+	if (fd_write_all(fd, &len, 4, true) < 0)
+		return -1;
+	return fd_write_all(fd, s, len, true);
+}
+
+/*
+** client_main
+**
+** Description:
+**   --client: forwards the command line to a server and reproduces its
+**   stdout, stderr and exit status. Returns -1 when --client is absent.
+*/
+int client_main(int argc, char **argv)
+{
+	struct sockaddr_un	addr;
+	char				buf[OUT_BUFSIZE];
+	char				hdr[5];
+	char				*path;
+	char				*cwd;
+	uint32_t			len;
+	uint32_t			n;
+	int					fd;
+	int					ok;
+
+	path = client_socket(&argc, argv);
+	if (!path)
+		return -1;
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || socket_address(path, &addr) < 0
+		|| connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		ft_putstr_fd(2, "ft_nm: '");
+		ft_putstr_fd(2, path);
+		ft_putstr_fd(2, "': Unable to connect\n");
+		return 1;
+	}
+	cwd = getcwd(NULL, 0);
+	n = argc;
+	ok = cwd && fd_write_all(fd, &n, 4, true) == 0 && client_send_str(fd, cwd) == 0;
+	for (int i = 1; ok && i < argc; i++)
+		ok = client_send_str(fd, argv[i]) == 0;
+	free(cwd);
+	while (ok && fd_read_all(fd, hdr, 5) == 0)
+	{
+		memcpy(&len, hdr + 1, 4);
+		if (hdr[0] == FRAME_EXIT)
+		{
+			out_flush(out_stdout());
+			close(fd);
+			return len;
+		}
+		for (; ok && len > 0; len -= n)
+		{
+			n = len < sizeof(buf) ? len : sizeof(buf);
+			ok = fd_read_all(fd, buf, n) == 0;
+			if (ok && hdr[0] == FRAME_STDOUT)
+				out_write(out_stdout(), buf, n);
+			else if (ok)
+			{
+				out_flush(out_stdout());
+				fd_write_all(2, buf, n, false);
+			}
+		}
+	}
+	out_flush(out_stdout());
+	ft_putstr_fd(2, "ft_nm: '");
+	ft_putstr_fd(2, path);
+	ft_putstr_fd(2, "': Connection to the server lost\n");
+	close(fd);
+	return 1;
+}
@@ -1,41 +1,833 @@
 #include "nm.h"
 
-int	cmp_sym(t_sym a, t_sym b, t_nm_flags flags)
+/*
+** sort_collation
+**
+** Description:
+**   0 when the LC_COLLATE locale orders names like strcmp (C, POSIX and
+**   C.UTF-8), otherwise a non-zero 24-bit hash of its name, which also
+**   keys the index caches.
+*/
+uint32_t sort_collation(void)
 {
-	int ret = ft_strncmp(a.name, b.name, 100000); // effectively strcmp
+	const char *name = setlocale(LC_COLLATE, NULL);
+
+	if (!name || strcmp(name, "C") == 0 || strcmp(name, "POSIX") == 0
+		|| strcmp(name, "C.UTF-8") == 0 || strcmp(name, "C.utf8") == 0)
+		return 0;
+	return (sysv_hash(name) & 0xffffff) | 1;
+}
+
+/*
+** sort_name
+**
+** Description:
+**   The string symbol `i` is sorted on: its name, or its collation key
+**   (see collate_keys).
+*/
+static inline const char *sort_name(const t_symset *set, uint32_t i)
+{
+	return set->coll ? set->coll[i] : symset_name(set, i);
+}
+
+/*
+** cmp_index
+**
+** Description:
+**   Orders symbols `a` and `b` of a set by name in the locale's collation,
+**   then bytewise like binutils, then by address (with -D by table
+**   position), honouring -r. With -n the address (undefined first) comes
+**   before the name. Used only when the sort keys could not be allocated.
+*/
+static int cmp_index(const t_symset *set, uint32_t a, uint32_t b, t_nm_flags flags)
+{
+	bool	ua = set->shndx[a] == SHN_UNDEF;
+	bool	ub = set->shndx[b] == SHN_UNDEF;
+	int		ret;
+
+	if (flags.numeric && (ua != ub || (!ua && set->addr[a] != set->addr[b])))
+		return ((ua != ub ? ua : set->addr[a] < set->addr[b]) != (flags.r != 0)) ? -1 : 1;
+	ret = strcoll(symset_name(set, a), symset_name(set, b));
+	if (ret == 0)
+		ret = strcmp(symset_name(set, a), symset_name(set, b));
 	if (ret != 0)
 		return (flags.r ? -ret : ret);
-	
-	if (a.addr < b.addr)
-		return (flags.r ? 1 : -1);
-	if (a.addr > b.addr)
-		return (flags.r ? -1 : 1);
-	return (0);
+	if (!flags.dynamic && set->addr[a] != set->addr[b])
+		return ((set->addr[a] < set->addr[b]) != (flags.r != 0)) ? -1 : 1;
+	if (a == b)
+		return 0;
+	// -D and -n: like binutils, equal names keep their table order, even with -r
+	return ((a < b) != (flags.r && !flags.dynamic && !flags.numeric)) ? -1 : 1;
+}
+
+/*
+** load_prefix
+**
+** Description:
+**   Packs the first 8 bytes of `name` big-endian into an integer, padding
+**   with zeros after the terminator, so that comparing two prefixes as
+**   integers gives the same order as strcmp on those bytes.
+*/
+static uint64_t load_prefix(const char *name)
+{
+	uint64_t	prefix = 0;
+	int			i = 0;
+
+	while (i < 8 && name[i])
+	{
+		prefix |= (uint64_t)(unsigned char)name[i] << (56 - 8 * i);
+		i++;
+	}
+	return prefix;
 }
 
-void sort(t_sym *array, int size, t_nm_flags flags)
+/*
+** cmp_key
+**
+** Description:
+**   Ascending name-then-address order on two keys whose names are known
+**   to share their first `depth` bytes. The names are only dereferenced
+**   when both prefixes are equal and not yet terminated. Equal collation
+**   keys fall back to the bytes of the names.
+*/
+static int cmp_key(const t_sort_key *a, const t_sort_key *b, const t_symset *set, size_t depth)
 {
-	int i;
-	int j;
-	t_sym temp;
+	int ret;
 
-	if (flags.p)
+	if (a->prefix != b->prefix)
+		return (a->prefix < b->prefix) ? -1 : 1;
+	if (a->prefix & 0xff)
+	{
+		ret = strcmp(sort_name(set, a->idx) + depth + 8, sort_name(set, b->idx) + depth + 8);
+		if (ret != 0)
+			return ret;
+	}
+	if (set->coll && (ret = strcmp(symset_name(set, a->idx), symset_name(set, b->idx))) != 0)
+		return ret;
+	if (a->addr == b->addr)
+		return 0;
+	return (a->addr < b->addr) ? -1 : 1;
+}
+
+static void key_insertion_sort(t_sort_key *keys, size_t n, const t_symset *set, size_t depth)
+{
+	t_sort_key	tmp;
+	size_t		j;
+
+	for (size_t i = 1; i < n; i++)
+	{
+		if (cmp_key(&keys[i - 1], &keys[i], set, depth) <= 0)
+			continue;
+		tmp = keys[i];
+		j = i;
+		while (j > 0 && cmp_key(&keys[j - 1], &tmp, set, depth) > 0)
+		{
+			keys[j] = keys[j - 1];
+			j--;
+		}
+		keys[j] = tmp;
+	}
+}
+
+/*
+** key_radix_sort
+**
+** Description:
+**   Stable LSD radix sort of `n` keys on their 8-byte prefix, using `tmp`
+**   as the other half of a ping-pong buffer. Byte positions where every
+**   key falls in the same bucket (shared prefixes) are skipped.
+*/
+static void key_radix_sort(t_sort_key *keys, t_sort_key *tmp, size_t n)
+{
+	static __thread size_t	count[8][256];
+	t_sort_key				*src = keys;
+	t_sort_key				*dst = tmp;
+	t_sort_key				*swap;
+	size_t					sum;
+	size_t					c;
+
+	memset(count, 0, sizeof(count));
+	for (size_t i = 0; i < n; i++)
+		for (int b = 0; b < 8; b++)
+			count[b][(keys[i].prefix >> (8 * b)) & 0xff]++;
+	for (int b = 0; b < 8; b++)
+	{
+		if (count[b][(keys[0].prefix >> (8 * b)) & 0xff] == n)
+			continue;
+		sum = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			c = count[b][d];
+			count[b][d] = sum;
+			sum += c;
+		}
+		for (size_t i = 0; i < n; i++)
+			dst[count[b][(src[i].prefix >> (8 * b)) & 0xff]++] = src[i];
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != keys)
+		memcpy(keys, src, n * sizeof(t_sort_key));
+}
+
+/*
+** key_merge_sort
+**
+** Description:
+**   Stable top-down merge sort of `n` keys with cmp_key, using `tmp` (as
+**   large) as scratch space. Leaves of up to 32 keys are insertion sorted.
+*/
+static void key_merge_sort(t_sort_key *keys, t_sort_key *tmp, size_t n, const t_symset *set,
+	size_t depth)
+{
+	size_t	half = n / 2;
+	size_t	i = 0;
+	size_t	j = half;
+	size_t	k = 0;
+
+	if (n <= 32)
+	{
+		key_insertion_sort(keys, n, set, depth);
 		return;
+	}
+	key_merge_sort(keys, tmp, half, set, depth);
+	key_merge_sort(keys + half, tmp + half, n - half, set, depth);
+	if (cmp_key(&keys[half - 1], &keys[half], set, depth) <= 0)
+		return;
+	while (i < half && j < n)
+		tmp[k++] = cmp_key(&keys[j], &keys[i], set, depth) < 0 ? keys[j++] : keys[i++];
+	while (i < half)
+		tmp[k++] = keys[i++];
+	memcpy(keys, tmp, k * sizeof(t_sort_key));
+}
+
+/*
+** key_sort_ended
+**
+** Description:
+**   Sorts a run of keys whose names all ended within the same prefix:
+**   identical names, which only need the address tie-break, so a radix
+**   sort on the addresses does. With collation keys, names that collate
+**   the same may still differ, and go through key_merge_sort.
+**
+** Why:
+**   Addresses within such a run are in no particular order: an insertion
+**   sort over thousands of symbols named `_` or `.L0` is quadratic.
+*/
+static void key_sort_ended(t_sort_key *keys, t_sort_key *tmp, size_t n, const t_symset *set,
+	size_t depth)
+{
+	if (n <= 32)
+		key_insertion_sort(keys, n, set, depth);
+	else if (set->coll)
+		key_merge_sort(keys, tmp, n, set, depth);
+	else
+	{
+		// the prefixes are not needed anymore, callers reload them
+		for (size_t k = 0; k < n; k++)
+			keys[k].prefix = keys[k].addr;
+		key_radix_sort(keys, tmp, n);
+	}
+}
 
+/*
+** key_sort
+**
+** Description:
+**   MSD string sort of `n` keys whose names share their first `depth`
+**   bytes: radix sort on the next 8 bytes, then recurse into every run of
+**   equal, unterminated prefixes with the following 8 bytes loaded.
+**   Runs whose names ended are identical names and only need the address
+**   tie-break (see key_sort_ended). Small ranges fall back to insertion
+**   sort.
+**
+** Why:
+**   Names are read sequentially, 8 bytes per level, instead of once per
+**   comparison; long shared prefixes such as `_ZNSt7__cxx11` cost one
+**   skipped radix level each rather than a strcmp in every comparison.
+*/
+static void key_sort(t_sort_key *keys, t_sort_key *tmp, size_t n, const t_symset *set, size_t depth)
+{
+	size_t	i;
+	size_t	j;
+
+	if (n <= 32)
+	{
+		key_insertion_sort(keys, n, set, depth);
+		return;
+	}
+	key_radix_sort(keys, tmp, n);
 	i = 0;
-	while (i < size)
+	while (i < n)
 	{
 		j = i + 1;
-		while (j < size)
+		while (j < n && keys[j].prefix == keys[i].prefix)
+			j++;
+		if (j - i > 1)
 		{
-			if (cmp_sym(array[i], array[j], flags) > 0)
+			if (keys[i].prefix & 0xff)
 			{
-				temp = array[i];
-				array[i] = array[j];
-				array[j] = temp;
+				for (size_t k = i; k < j; k++)
+					keys[k].prefix = load_prefix(sort_name(set, keys[k].idx) + depth + 8);
+				key_sort(keys + i, tmp + i, j - i, set, depth + 8);
 			}
+			else
+				key_sort_ended(keys + i, tmp + i, j - i, set, depth);
+		}
+		i = j;
+	}
+}
+
+/*
+** order_insertion_sort
+**
+** Description:
+**   Stable insertion sort of order[0, n), for the small leaves of
+**   order_merge_sort.
+*/
+static void order_insertion_sort(const t_symset *set, uint32_t *order, size_t n, t_nm_flags flags)
+{
+	uint32_t	tmp;
+	size_t		j;
+
+	for (size_t i = 1; i < n; i++)
+	{
+		tmp = order[i];
+		j = i;
+		while (j > 0 && cmp_index(set, order[j - 1], tmp, flags) > 0)
+		{
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = tmp;
+	}
+}
+
+/*
+** order_merge_sort
+**
+** Description:
+**   Stable top-down merge sort of order[0, n) with cmp_index, using `tmp`
+**   (as large) as scratch space, for when the sort keys could not be
+**   allocated.
+**
+** Why:
+**   That happens on the largest tables, where only an O(n log n) sort
+**   finishes; the scratch space is a twelfth of the keys'.
+*/
+static void order_merge_sort(const t_symset *set, uint32_t *order, uint32_t *tmp, size_t n,
+	t_nm_flags flags)
+{
+	size_t	half = n / 2;
+	size_t	i = 0;
+	size_t	j = half;
+	size_t	k = 0;
+
+	if (n <= 16)
+	{
+		order_insertion_sort(set, order, n, flags);
+		return;
+	}
+	order_merge_sort(set, order, tmp, half, flags);
+	order_merge_sort(set, order + half, tmp + half, n - half, flags);
+	// already in order: nothing to merge
+	if (cmp_index(set, order[half - 1], order[half], flags) <= 0)
+		return;
+	while (i < half && j < n)
+		tmp[k++] = cmp_index(set, order[j], order[i], flags) < 0 ? order[j++] : order[i++];
+	while (i < half)
+		tmp[k++] = order[i++];
+	memcpy(order, tmp, k * sizeof(uint32_t));
+}
+
+typedef struct s_sort_split {
+	const t_symset	*set;
+	t_sort_key		*keys;
+	t_sort_key		*tmp;
+	uint32_t		*order;
+	size_t			size;
+	bool			r;
+	size_t			*cut;
+}	t_sort_split;
+
+typedef struct s_merge_head {
+	uint64_t	prefix;
+	size_t		pos;
+	size_t		end;
+	int			run;
+}	t_merge_head;
+
+/*
+** cmp_head
+**
+** Description:
+**   Full name, address, index order of the keys at the head of two sorted
+**   runs.
+*/
+static int cmp_head(const t_merge_head *a, const t_merge_head *b, const t_sort_split *s)
+{
+	const t_sort_key	*ka = &s->keys[a->pos];
+	const t_sort_key	*kb = &s->keys[b->pos];
+	int					ret;
+
+	if (a->prefix != b->prefix)
+		return (a->prefix < b->prefix) ? -1 : 1;
+	if (a->prefix & 0xff)
+	{
+		ret = strcmp(sort_name(s->set, ka->idx) + 8, sort_name(s->set, kb->idx) + 8);
+		if (ret != 0)
+			return ret;
+	}
+	if (s->set->coll && (ret = strcmp(symset_name(s->set, ka->idx), symset_name(s->set, kb->idx))) != 0)
+		return ret;
+	if (ka->addr != kb->addr)
+		return (ka->addr < kb->addr) ? -1 : 1;
+	return (ka->idx < kb->idx) ? -1 : 1;
+}
+
+static void head_load(t_merge_head *h, const t_sort_split *s)
+{
+	h->prefix = s->keys[h->pos].prefix;
+}
+
+// restores the min-heap of run heads below `i`
+static void heap_down(t_merge_head *heap, int n, int i, const t_sort_split *s)
+{
+	t_merge_head	tmp;
+	int				c;
+
+	while ((c = 2 * i + 1) < n)
+	{
+		if (c + 1 < n && cmp_head(&heap[c + 1], &heap[c], s) < 0)
+			c++;
+		if (cmp_head(&heap[c], &heap[i], s) >= 0)
+			break;
+		tmp = heap[c];
+		heap[c] = heap[i];
+		heap[i] = tmp;
+		i = c;
+	}
+}
+
+static void split_sort(void *ctx, int part, int parts)
+{
+	t_sort_split	*s = ctx;
+	size_t			lo = split_bound(s->size, part, parts);
+	size_t			hi = split_bound(s->size, part + 1, parts);
+
+	key_sort(s->keys + lo, s->tmp + lo, hi - lo, s->set, 0);
+	// key_sort leaves deeper prefixes behind, the merge needs the first ones
+	for (size_t i = lo; i < hi; i++)
+		s->keys[i].prefix = load_prefix(sort_name(s->set, s->keys[i].idx));
+}
+
+/*
+** split_merge
+**
+** Description:
+**   Output part `part` of the merge: a heap merge of its share of every
+**   sorted run (see merge_cuts), written straight into the print order
+**   from its rank on.
+*/
+static void split_merge(void *ctx, int part, int parts)
+{
+	t_sort_split	*s = ctx;
+	t_merge_head	heap[SPLIT_MAX];
+	int				n = 0;
+	size_t			pos = 0;
+
+	for (int r = 0; r < parts; r++)
+	{
+		heap[n].pos = s->cut[part * parts + r];
+		heap[n].end = s->cut[(part + 1) * parts + r];
+		pos += heap[n].pos - split_bound(s->size, r, parts);
+		if (heap[n].pos < heap[n].end)
+			head_load(&heap[n++], s);
+	}
+	for (int i = n / 2 - 1; i >= 0; i--)
+		heap_down(heap, n, i, s);
+	while (n > 0)
+	{
+		s->order[s->r ? s->size - 1 - pos : pos] = s->keys[heap[0].pos].idx;
+		pos++;
+		if (++heap[0].pos < heap[0].end)
+			head_load(&heap[0], s);
+		else
+			heap[0] = heap[--n];
+		heap_down(heap, n, 0, s);
+	}
+}
+
+/*
+** cut_run
+**
+** Description:
+**   Position in sorted run `r` of the first key not below `split`.
+*/
+static size_t cut_run(t_sort_split *s, int r, int parts, const t_merge_head *split)
+{
+	size_t			lo = split_bound(s->size, r, parts);
+	size_t			hi = split_bound(s->size, r + 1, parts);
+	t_merge_head	h;
+
+	while (lo < hi)
+	{
+		h.pos = lo + (hi - lo) / 2;
+		head_load(&h, s);
+		if (cmp_head(&h, split, s) < 0)
+			lo = h.pos + 1;
+		else
+			hi = h.pos;
+	}
+	return lo;
+}
+
+/*
+** merge_cuts
+**
+** Description:
+**   Cuts every sorted run into `parts` shares, part p of the output taking
+**   the keys not below splitter p - 1 and below splitter p. The splitters
+**   are every parts-th of `parts` keys sampled evenly from each run, so
+**   that the shares stay balanced whatever the order of the table.
+*/
+static void merge_cuts(t_sort_split *s, int parts)
+{
+	t_merge_head	heap[SPLIT_MAX];
+	size_t			lo;
+	size_t			len;
+	int				n = 0;
+	int				taken = 0;
+	int				p = 1;
+
+	for (int r = 0; r < parts; r++)
+	{
+		s->cut[r] = split_bound(s->size, r, parts);
+		s->cut[parts * parts + r] = split_bound(s->size, r + 1, parts);
+		// `end` counts the samples taken from the run
+		heap[n] = (t_merge_head){0, s->cut[r], 0, r};
+		head_load(&heap[n++], s);
+	}
+	for (int i = n / 2 - 1; i >= 0; i--)
+		heap_down(heap, n, i, s);
+	while (p < parts)
+	{
+		if (++taken % parts == 0)
+		{
+			for (int r = 0; r < parts; r++)
+				s->cut[p * parts + r] = cut_run(s, r, parts, &heap[0]);
+			p++;
+		}
+		lo = s->cut[heap[0].run];
+		len = s->cut[parts * parts + heap[0].run] - lo;
+		if (++heap[0].end < (size_t)parts)
+		{
+			heap[0].pos = lo + heap[0].end * len / parts;
+			head_load(&heap[0], s);
+		}
+		else
+			heap[0] = heap[--n];
+		heap_down(heap, n, 0, s);
+	}
+}
+
+/*
+** sort_split
+**
+** Description:
+**   Parallel version of the key sort: the keys are cut into `parts` runs
+**   sorted by as many threads, then merged by as many threads, each one
+**   producing a contiguous share of the print order. Keys that compare
+**   equal in key_sort keep their index order there and in the merge, so
+**   the order is exactly the sequential one.
+*/
+static int sort_split(t_symset *set, t_sort_key *keys, int parts, t_nm_flags flags)
+{
+	t_sort_split s;
+
+	s.cut = arena_alloc(sizeof(size_t) * (parts + 1) * parts);
+	if (!s.cut)
+		return -1;
+	s.set = set;
+	s.keys = keys;
+	s.tmp = keys + set->count;
+	s.order = set->order;
+	s.size = set->count;
+	s.r = flags.r;
+	run_split(parts, split_sort, &s);
+	merge_cuts(&s, parts);
+	run_split(parts, split_merge, &s);
+	return 0;
+}
+
+/*
+** collate_keys
+**
+** Description:
+**   Points set->coll at the strxfrm key of every name, built once into
+**   the arena in 64 KiB chunks. Comparing two keys with strcmp gives the
+**   same answer as strcoll on the names. Returns -1 if memory ran out.
+**
+** Why:
+**   strcoll transforms both names again in every one of the n log n
+**   comparisons. With keys the usual prefix and radix sort applies, at
+**   the price of one transformation per name.
+*/
+static int collate_keys(t_symset *set)
+{
+	char	buf[256];
+	char	*chunk = NULL;
+	size_t	left = 0;
+	size_t	n;
+
+	set->coll = arena_alloc(sizeof(char *) * set->count);
+	if (!set->coll)
+		return -1;
+	for (size_t i = 0; i < set->count; i++)
+	{
+		n = strxfrm(buf, symset_name(set, i), sizeof(buf)) + 1;
+		if (n > left)
+		{
+			left = n > ((size_t)1 << 16) ? n : ((size_t)1 << 16);
+			if (!(chunk = arena_alloc(left)))
+			{
+				set->coll = NULL;
+				return -1;
+			}
+		}
+		if (n <= sizeof(buf))
+			memcpy(chunk, buf, n);
+		else
+			strxfrm(chunk, symset_name(set, i), n);
+		set->coll[i] = chunk;
+		chunk += n;
+		left -= n;
+	}
+	return 0;
+}
+
+/*
+** key_sort_ties
+**
+** Description:
+**   After a radix sort on an integer in the prefixes, sorts every run of
+**   keys that share it by name and address with key_sort.
+*/
+static void key_sort_ties(t_sort_key *keys, t_sort_key *tmp, size_t n, const t_symset *set)
+{
+	size_t j;
+
+	for (size_t i = 0; i < n; i = j)
+	{
+		j = i + 1;
+		while (j < n && keys[j].prefix == keys[i].prefix)
 			j++;
+		if (j - i == 1)
+			continue;
+		for (size_t k = i; k < j; k++)
+			keys[k].prefix = load_prefix(sort_name(set, keys[k].idx));
+		key_sort(keys + i, tmp + i, j - i, set, 0);
+	}
+}
+
+/*
+** sort_by_size
+**
+** Description:
+**   The --size-sort order: the symbols it lists (see sym_shown) by size,
+**   equal sizes by name and address like the plain sort, then the others.
+**   Sizes go through key_radix_sort, which skips the bytes every size
+**   shares, and only runs of equal sizes are then sorted by name with
+**   key_sort. -r reverses the listed part, but for symbols of the same
+**   name. Returns -1 if the keys could not be allocated.
+**
+** Why:
+**   Sizes are plain integers, so ordering them takes a few linear passes
+**   over the keys; names are only read to break ties.
+*/
+static int sort_by_size(t_symset *set, t_nm_flags flags)
+{
+	t_sort_key	*keys = arena_alloc(sizeof(t_sort_key) * set->count * 2);
+	t_sort_key	*tmp = keys + set->count;
+	size_t		rest = set->count;
+	size_t		n = 0;
+	size_t		i;
+
+	if (!keys)
+		return -1;
+	// like binutils, equal names go by address then table order, even with -r
+	for (size_t k = 0; k < set->count; k++)
+	{
+		i = flags.r ? set->count - 1 - k : k;
+		if (set->shndx[i] == SHN_UNDEF || set->shndx[i] == SHN_ABS || set->size[i] == 0)
+		{
+			set->order[--rest] = i;
+			continue;
 		}
-		i++;
+		keys[n].prefix = set->size[i];
+		keys[n].addr = flags.r ? ~set->addr[i] : set->addr[i];
+		keys[n].idx = i;
+		n++;
+	}
+	if (n > 1)
+		key_radix_sort(keys, tmp, n);
+	key_sort_ties(keys, tmp, n, set);
+	for (i = 0; i < n; i++)
+		set->order[flags.r ? n - 1 - i : i] = keys[i].idx;
+	return 0;
+}
+
+/*
+** sort_by_address
+**
+** Description:
+**   The -n order of binutils: undefined symbols first, by name, then the
+**   others by address, equal addresses by name, equal names in table
+**   order. The addresses go through key_radix_sort, which skips the bytes
+**   every address shares (the upper half of ELF32 addresses among them),
+**   and only symbols sharing an address are then sorted by name. -r
+**   reverses the whole order, but for symbols of the same name.
+**
+** Why:
+**   Ordering by address takes a few linear passes over the keys whatever
+**   the table size; names are only read to break ties.
+*/
+static void sort_by_address(t_symset *set, t_sort_key *keys, t_nm_flags flags)
+{
+	t_sort_key	*tmp = keys + set->count;
+	t_sort_key	*k;
+	size_t		u = 0;
+	size_t		n = set->count;
+
+	for (size_t i = 0; i < set->count; i++)
+	{
+		// undefined symbols at the front, whatever their value
+		k = set->shndx[i] == SHN_UNDEF ? &keys[u++] : &keys[--n];
+		k->prefix = set->shndx[i] == SHN_UNDEF ? 0 : set->addr[i];
+		k->addr = flags.r ? (uint64_t)(set->count - 1 - i) : (uint64_t)i;
+		k->idx = i;
+	}
+	if (set->count - u > 1)
+		key_radix_sort(keys + u, tmp, set->count - u);
+	key_sort_ties(keys, tmp, u, set);
+	key_sort_ties(keys + u, tmp, set->count - u, set);
+	for (size_t i = 0; i < set->count; i++)
+		set->order[flags.r ? set->count - 1 - i : i] = keys[i].idx;
+}
+
+/*
+** range_search
+**
+** Description:
+**   Position in the -n print order of the first defined symbol at or
+**   past `addr` in print direction: at or above it, with -r below it.
+*/
+static size_t range_search(const t_symset *set, t_nm_flags flags, uint64_t addr)
+{
+	size_t	lo = 0;
+	size_t	hi = set->count;
+	size_t	mid;
+	size_t	i;
+	bool	before;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		i = set->order[mid];
+		if (flags.r)
+			before = set->shndx[i] != SHN_UNDEF && set->addr[i] >= addr;
+		else
+			before = set->shndx[i] == SHN_UNDEF || set->addr[i] < addr;
+		if (before)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+** sort_range
+**
+** Description:
+**   The slice [lo, hi) of the print order that printSet has to walk. With
+**   -n and --start-address or --stop-address, it holds exactly the
+**   defined symbols in [start, stop) and is found by binary search;
+**   otherwise it is the whole order, sym_shown filtering the addresses.
+*/
+void sort_range(const t_symset *set, t_nm_flags flags, size_t *lo, size_t *hi)
+{
+	*lo = 0;
+	*hi = set->count;
+	if (!flags.range || !flags.numeric || flags.size_sort || !set->order)
+		return;
+	*lo = range_search(set, flags, flags.r ? flags.stop_address : flags.start_address);
+	*hi = range_search(set, flags, flags.r ? flags.start_address : flags.stop_address);
+}
+
+/*
+** sort
+**
+** Description:
+**   Computes the print order of a symbol set unless -p was given, in
+**   which case it stays the table order. Returns -1 if the order, or
+**   the scratch space of the fallback sort, could not be allocated.
+**
+** Why:
+**   Following names into the string table on every comparison is mostly
+**   cache misses. The sort runs instead on a compact array of
+**   {name prefix, address, index} keys (see key_sort), and only the
+**   sorted indexes are kept: the symbols themselves never move. -r is the
+**   exact reverse of the ascending order. The keys and the order come
+**   from the file's arena (see arena.c). Outside the C collation names
+**   are ordered like binutils does with strcoll, through collation keys
+**   (see collate_keys). -n and --size-sort have orders of their own (see
+**   sort_by_address and sort_by_size).
+*/
+int sort(t_symset *set, t_nm_flags flags)
+{
+	t_sort_key	*keys;
+	uint32_t	*tmp;
+	size_t		size = set->count;
+
+	if (flags.p || size < 2)
+		return 0;
+	set->order = arena_alloc(sizeof(uint32_t) * size);
+	if (!set->order)
+		return -1;
+	if (flags.size_sort)
+		return (sort_collation() && collate_keys(set) < 0) ? -1 : sort_by_size(set, flags);
+	keys = NULL;
+	if (!sort_collation() || collate_keys(set) == 0)
+		keys = arena_alloc(sizeof(t_sort_key) * size * 2);
+	if (!keys)
+	{
+		if (!(tmp = arena_alloc(sizeof(uint32_t) * size)))
+			return -1;
+		for (size_t i = 0; i < size; i++)
+			set->order[i] = i;
+		order_merge_sort(set, set->order, tmp, size, flags);
+		return 0;
+	}
+	if (flags.numeric)
+	{
+		sort_by_address(set, keys, flags);
+		return 0;
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		keys[i].prefix = load_prefix(sort_name(set, i));
+		keys[i].addr = set->addr[i];
+		// -D: like binutils, equal names keep their table order, even with -r
+		if (flags.dynamic)
+			keys[i].addr = flags.r ? (uint64_t)(size - 1 - i) : (uint64_t)i;
+		keys[i].idx = i;
 	}
+	if (split_count(size, flags) > 1 && sort_split(set, keys, split_count(size, flags), flags) == 0)
+		return 0;
+	key_sort(keys, keys + size, size, set, 0);
+	for (size_t i = 0; i < size; i++)
+		set->order[flags.r ? size - 1 - i : i] = keys[i].idx;
+	return 0;
 }
@@ -0,0 +1,407 @@
+// RUSAGE_THREAD needs _GNU_SOURCE, defined before any header
+#define _GNU_SOURCE
+#include "nm.h"
+#include <malloc.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/*
+** Instrumentation (--stats, FT_NM_STATS)
+**
+** Description:
+**   Splits the time spent on every input file into phases: mapping (or
+**   reading, with --stream), the symbol table walk, classification into
+**   nm letters, sorting, printing, and everything else. It also counts
+**   symbols scanned, kept and printed, bytes mapped and bytes of ELF
+**   structures read, page faults, bytes written to stdout and how many
+**   write syscalls that took, the largest heap in use seen at a phase
+**   boundary and the arena's high-water mark. A
+**   report is printed to stderr for each file and for the whole run,
+**   either as text or as one JSON object per line.
+**
+**   The statistics of the file being processed by a thread are reached
+**   through a thread-local pointer; every hook returns at once when it is
+**   NULL, so a run without --stats only pays a few calls per file.
+**
+** Why:
+**   When a run is slow it is impossible to tell from the outside whether
+**   the time goes to page faults, the symbol walk, the sort or the output.
+*/
+
+static const char *g_phase_names[STATS_PHASES] = {
+	"map", "scan", "classify", "sort", "print", "other"
+};
+
+static const char *g_counter_names[STATS_COUNTERS] = {
+	"scanned", "kept", "printed", "bytes_mapped", "bytes_touched"
+};
+
+static __thread t_stats	*g_stats = NULL;
+static pthread_mutex_t	g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+** stats_heap
+**
+** Description:
+**   Bytes currently allocated by malloc, including large mmap'ed blocks.
+**   This covers every thread, so with -j the per-file figure is shared.
+**   It is only sampled when a file starts and at each phase boundary, so
+**   the reported "heap sampled" is the largest of those samples: memory
+**   allocated and freed within a phase is not seen, and it is not a peak.
+*/
+static size_t stats_heap(void)
+{
+	struct mallinfo2 mi = mallinfo2();
+
+	return mi.uordblks + mi.hblkhd;
+}
+
+/*
+** stats_mode
+**
+** Description:
+**   Parses the value of --stats or FT_NM_STATS: "" or "text" for the text
+**   report, "json" for JSON lines. Returns -1 for anything else.
+*/
+int stats_mode(const char *value)
+{
+	if (!value || !*value || strcmp(value, "text") == 0 || strcmp(value, "1") == 0)
+		return STATS_TEXT;
+	if (strcmp(value, "json") == 0)
+		return STATS_JSON;
+	return -1;
+}
+
+t_stats *stats_current(void)
+{
+	return g_stats;
+}
+
+/*
+** stats_begin
+**
+** Description:
+**   Starts accounting on the calling thread for the input `name`.
+*/
+void stats_begin(t_stats *st, const char *name)
+{
+	struct rusage ru;
+
+	memset(st, 0, sizeof(*st));
+	st->name = name;
+	st->files = 1;
+	getrusage(RUSAGE_THREAD, &ru);
+	st->minflt = -ru.ru_minflt;
+	st->majflt = -ru.ru_majflt;
+	st->out_start = out_tell(out_stdout());
+	st->writes_start = out_stdout()->syscalls;
+	st->heap_sampled = stats_heap();
+	if (arena_current())
+		arena_current()->high = arena_current()->used;
+	st->start = stats_now();
+	st->mark = st->start;
+	g_stats = st;
+}
+
+/*
+** stats_phase
+**
+** Description:
+**   Charges the time since the previous call to `phase`.
+*/
+void stats_phase(t_phase phase)
+{
+	uint64_t	now;
+	size_t		heap;
+
+	if (!g_stats)
+		return;
+	now = stats_now();
+	g_stats->ns[phase] += now - g_stats->mark;
+	g_stats->mark = now;
+	heap = stats_heap();
+	if (heap > g_stats->heap_sampled)
+		g_stats->heap_sampled = heap;
+}
+
+void stats_add(t_counter counter, size_t n)
+{
+	if (g_stats)
+		g_stats->count[counter] += n;
+}
+
+/*
+** stats_stop
+**
+** Description:
+**   Closes the current phase and the page fault count of the calling
+**   thread, and detaches `st` from it.
+*/
+static void stats_stop(t_stats *st)
+{
+	struct rusage ru;
+
+	stats_phase(STATS_OTHER);
+	getrusage(RUSAGE_THREAD, &ru);
+	st->minflt += ru.ru_minflt;
+	st->majflt += ru.ru_majflt;
+	st->total_ns = stats_now() - st->start;
+	st->arena_peak = arena_current() ? arena_current()->high : 0;
+	g_stats = NULL;
+}
+
+/*
+** stats_merge
+**
+** Description:
+**   Adds `src` to `dst`. Output counts are only added when `output` is
+**   set: an archive member parsed by a -j worker writes into a capture
+**   that its archive's own figures already cover once replayed.
+*/
+static void stats_merge(t_stats *dst, t_stats *src, bool output)
+{
+	pthread_mutex_lock(&g_stats_lock);
+	for (int i = 0; i < STATS_PHASES; i++)
+		dst->ns[i] += src->ns[i];
+	for (int i = 0; i < STATS_COUNTERS; i++)
+		dst->count[i] += src->count[i];
+	dst->minflt += src->minflt;
+	dst->majflt += src->majflt;
+	if (output)
+	{
+		dst->files += src->files;
+		dst->total_ns += src->total_ns;
+		dst->out_bytes += src->out_bytes;
+		dst->writes += src->writes;
+	}
+	if (src->heap_sampled > dst->heap_sampled)
+		dst->heap_sampled = src->heap_sampled;
+	if (src->arena_peak > dst->arena_peak)
+		dst->arena_peak = src->arena_peak;
+	pthread_mutex_unlock(&g_stats_lock);
+}
+
+/*
+** stats_join
+**
+** Description:
+**   Ends a -j worker's accounting of one archive member and adds it to the
+**   archive being listed by another thread.
+*/
+void stats_join(t_stats *st, t_stats *parent)
+{
+	stats_stop(st);
+	stats_merge(parent, st, false);
+}
+
+static void put_num(t_out *out, uint64_t n)
+{
+	char	tmp[20];
+	int		i = 20;
+
+	do
+		tmp[--i] = '0' + n % 10;
+	while (n /= 10);
+	out_write(out, tmp + i, 20 - i);
+}
+
+/*
+** put_ms
+**
+** Description:
+**   Prints a nanosecond duration as milliseconds with three decimals.
+*/
+static void put_ms(t_out *out, uint64_t ns)
+{
+	uint64_t us = (ns + 500) / 1000;
+
+	put_num(out, us / 1000);
+	out_putc(out, '.');
+	out_putc(out, '0' + us / 100 % 10);
+	out_putc(out, '0' + us / 10 % 10);
+	out_putc(out, '0' + us % 10);
+}
+
+static void put_json_string(t_out *out, const char *s)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	out_putc(out, '"');
+	for (; *s; s++)
+	{
+		unsigned char c = *s;
+		if (c == '"' || c == '\\')
+		{
+			out_putc(out, '\\');
+			out_putc(out, c);
+		}
+		else if (c < 0x20)
+		{
+			out_str(out, "\\u00");
+			out_putc(out, hex[c >> 4]);
+			out_putc(out, hex[c & 15]);
+		}
+		else
+			out_putc(out, c);
+	}
+	out_putc(out, '"');
+}
+
+static void stats_text(t_out *out, t_stats *st, long maxrss)
+{
+	out_str(out, "ft_nm: stats '");
+	out_str(out, st->name ? st->name : "total");
+	out_str(out, "'");
+	if (!st->name)
+	{
+		out_str(out, " (");
+		put_num(out, st->files);
+		out_str(out, st->files == 1 ? " file)" : " files)");
+	}
+	out_str(out, "\n  time ms   total ");
+	put_ms(out, st->total_ns);
+	for (int i = 0; i < STATS_PHASES; i++)
+	{
+		out_str(out, "  ");
+		out_str(out, g_phase_names[i]);
+		out_putc(out, ' ');
+		put_ms(out, st->ns[i]);
+	}
+	out_str(out, "\n  symbols   scanned ");
+	put_num(out, st->count[STATS_SCANNED]);
+	out_str(out, "  kept ");
+	put_num(out, st->count[STATS_KEPT]);
+	out_str(out, "  printed ");
+	put_num(out, st->count[STATS_PRINTED]);
+	out_str(out, "\n  memory    mapped ");
+	put_num(out, st->count[STATS_MAPPED]);
+	out_str(out, "  touched ");
+	put_num(out, st->count[STATS_TOUCHED]);
+	out_str(out, "  faults ");
+	put_num(out, st->minflt);
+	out_str(out, " minor ");
+	put_num(out, st->majflt);
+	out_str(out, " major  heap sampled ");
+	put_num(out, st->heap_sampled);
+	out_str(out, "  arena peak ");
+	put_num(out, st->arena_peak);
+	if (maxrss >= 0)
+	{
+		out_str(out, "  max rss ");
+		put_num(out, (uint64_t)maxrss * 1024);
+	}
+	out_str(out, "\n  output    bytes ");
+	put_num(out, st->out_bytes);
+	out_str(out, "  writes ");
+	put_num(out, st->writes);
+	out_putc(out, '\n');
+}
+
+static void stats_json(t_out *out, t_stats *st, long maxrss)
+{
+	out_str(out, "{\"stats\":");
+	out_str(out, st->name ? "\"file\",\"file\":" : "\"total\",\"files\":");
+	if (st->name)
+		put_json_string(out, st->name);
+	else
+		put_num(out, st->files);
+	out_str(out, ",\"total_ns\":");
+	put_num(out, st->total_ns);
+	for (int i = 0; i < STATS_PHASES; i++)
+	{
+		out_str(out, ",\"");
+		out_str(out, g_phase_names[i]);
+		out_str(out, "_ns\":");
+		put_num(out, st->ns[i]);
+	}
+	for (int i = 0; i < STATS_COUNTERS; i++)
+	{
+		out_str(out, ",\"");
+		out_str(out, g_counter_names[i]);
+		out_str(out, "\":");
+		put_num(out, st->count[i]);
+	}
+	out_str(out, ",\"minor_faults\":");
+	put_num(out, st->minflt);
+	out_str(out, ",\"major_faults\":");
+	put_num(out, st->majflt);
+	out_str(out, ",\"heap_sampled\":");
+	put_num(out, st->heap_sampled);
+	out_str(out, ",\"arena_peak\":");
+	put_num(out, st->arena_peak);
+	if (maxrss >= 0)
+	{
+		out_str(out, ",\"max_rss\":");
+		put_num(out, (uint64_t)maxrss * 1024);
+	}
+	out_str(out, ",\"bytes_written\":");
+	put_num(out, st->out_bytes);
+	out_str(out, ",\"writes\":");
+	put_num(out, st->writes);
+	out_str(out, "}\n");
+}
+
+/*
+** stats_print
+**
+** Description:
+**   Formats a report in memory and prints it to stderr in one piece, so
+**   that reports of files processed by -j workers are never interleaved.
+*/
+static void stats_print(t_stats *st, int mode, long maxrss)
+{
+	t_out out;
+
+	out_init_memory(&out);
+	if (mode == STATS_JSON)
+		stats_json(&out, st, maxrss);
+	else
+		stats_text(&out, st, maxrss);
+	out_putc(&out, '\0');
+	if (out.buf)
+		ft_putstr_fd(2, out.buf);
+	out_free_memory(&out);
+}
+
+/*
+** stats_end
+**
+** Description:
+**   Ends the accounting of one input file, prints its report and adds it
+**   to the run's totals.
+*/
+void stats_end(t_stats *st, t_nm_flags flags)
+{
+	stats_stop(st);
+	st->out_bytes = out_tell(out_stdout()) - st->out_start;
+	st->writes = out_stdout()->syscalls - st->writes_start;
+	stats_print(st, flags.stats, -1);
+	if (flags.stats_total)
+		stats_merge(flags.stats_total, st, true);
+}
+
+/*
+** stats_report_total
+**
+** Description:
+**   Prints the totals of the run. Output written by -j workers is only
+**   sent to stdout when it is replayed, so the write count is taken from
+**   stdout itself.
+*/
+void stats_report_total(t_stats *total, t_nm_flags flags)
+{
+	struct rusage ru;
+
+	if (out_stdout()->fd >= 0)
+		total->writes = out_stdout()->syscalls;
+	getrusage(RUSAGE_SELF, &ru);
+	stats_print(total, flags.stats, ru.ru_maxrss);
+}
@@ -0,0 +1,136 @@
+#include "nm.h"
+
+/*
+** Streaming mode (--stream)
+**
+** Description:
+**   Instead of mapping the whole file, an address range as large as the
+**   file is reserved with an anonymous, unbacked mapping, and only the
+**   ranges the symbol listing needs are pread(2) into place at their
+**   file offsets: the ELF header, the section header table, .shstrtab,
+**   the symbol table and its string table. The rest of the range never
+**   gets a page. Everything is released before the next file.
+**
+** Why:
+**   Multi-gigabyte debug binaries spend nearly all of their bytes in
+**   sections nm never looks at. Because every section lands at its usual
+**   offset, the regular parser runs unchanged on the sparse image.
+*/
+
+/*
+** stream_loaded
+**
+** Description:
+**   Tells whether [offset, offset + len) has already been read.
+*/
+static bool stream_loaded(t_stream *st, uint64_t offset, uint64_t len)
+{
+	for (int i = 0; i < st->nranges; i++)
+		if (offset >= st->ranges[i][0] && offset + len <= st->ranges[i][1])
+			return true;
+	return false;
+}
+
+/*
+** stream_load
+**
+** Description:
+**   Reads [offset, offset + len) of the file into the sparse image,
+**   clamped to the file size. Returns -1 on a read error.
+*/
+int stream_load(t_stream *st, uint64_t offset, uint64_t len)
+{
+	ssize_t	ret;
+	size_t	done = 0;
+
+	if (offset >= st->size || len == 0)
+		return 0;
+	if (len > st->size - offset)
+		len = st->size - offset;
+	if (stream_loaded(st, offset, len))
+		return 0;
+	while (done < len)
+	{
+		ret = pread(st->fd, st->base + offset + done, len - done, offset + done);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+	st->bytes_read += done;
+	if (st->nranges < STREAM_MAX_RANGES)
+	{
+		st->ranges[st->nranges][0] = offset;
+		st->ranges[st->nranges][1] = offset + len;
+		st->nranges++;
+	}
+	return 0;
+}
+
+/*
+** stream_report
+**
+** Description:
+**   Prints how much of the file was actually read.
+*/
+static void stream_report(t_stream *st, char *filename)
+{
+	ft_putstr_fd(2, "ft_nm: '");
+	ft_putstr_fd(2, filename);
+	ft_putstr_fd(2, "': stream: ");
+	ft_putnbr_fd(2, st->bytes_read);
+	ft_putstr_fd(2, " bytes read of ");
+	ft_putnbr_fd(2, st->size);
+	ft_putstr_fd(2, " bytes\n");
+}
+
+/*
+** stream_file
+**
+** Description:
+**   Lists the symbols of an ELF file through a sparse image. Returns
+**   STREAM_FALLBACK for inputs that are not ELF (archives), which need the
+**   regular whole-file mapping.
+*/
+int stream_file(int fd, char *filename, size_t size, t_nm_flags flags)
+{
+	t_stream	st;
+	int			ret;
+
+	st.fd = fd;
+	st.size = size;
+	st.bytes_read = 0;
+	st.nranges = 0;
+	st.base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (st.base == MAP_FAILED)
+		return STREAM_FALLBACK;
+
+	ret = STREAM_FALLBACK;
+	if (stream_load(&st, 0, sizeof(Elf64_Ehdr)) == 0 && size >= EI_NIDENT
+		&& st.base[EI_MAG0] == ELFMAG0 && st.base[EI_MAG1] == ELFMAG1
+		&& st.base[EI_MAG2] == ELFMAG2 && st.base[EI_MAG3] == ELFMAG3)
+	{
+		if (st.base[EI_CLASS] == ELFCLASS64)
+			ret = elf64_stream_sections(&st, flags);
+		else if (st.base[EI_CLASS] == ELFCLASS32)
+			ret = elf32_stream_sections(&st, flags);
+		if (ret < 0)
+		{
+			ft_putstr_fd(2, "ft_nm: '");
+			ft_putstr_fd(2, filename);
+			ft_putstr_fd(2, "': Unable to read file\n");
+			ret = 1;
+		}
+		else if (ret == 0)
+		{
+			stats_phase(STATS_MAP);
+			stats_add(STATS_MAPPED, st.bytes_read);
+			ret = nm_buffer(st.base, size, filename, flags);
+			stream_report(&st, filename);
+		}
+	}
+	munmap(st.base, size);
+	return ret;
+}
@@ -0,0 +1,154 @@
+#include "nm.h"
+
+/*
+** String pool and string-keyed hash index (t_strpool, t_strmap)
+**
+** Description:
+**   The two halves of the interning tables of --xref and -C. A t_strpool
+**   copies strings into 1 MiB blocks chained through their first word,
+**   all released at once by strpool_free. A t_strmap indexes an array of
+**   records owned by its caller, each holding a string key and its hash
+**   at the offsets given to strmap_init: open addressing with linear
+**   probing, slots holding record index + 1 (0 being empty), kept at most
+**   half full.
+**
+** Why:
+**   Names are interned once per run however many files repeat them: one
+**   malloc per block instead of one per string, and a probe that compares
+**   the stored hash before the string. Both tables used to carry their
+**   own copy of this code.
+*/
+
+#define STRPOOL_BLOCK ((size_t)1 << 20)
+#define STRMAP_MIN_SLOTS 1024
+
+/*
+** strpool_dup
+**
+** Description:
+**   Copies the `len` bytes of `s` and a terminating NUL into the pool.
+**   The copy lives until strpool_free. Returns NULL if memory ran out.
+*/
+char *strpool_dup(t_strpool *p, const char *s, size_t len)
+{
+	char *block;
+	char *copy;
+
+	if (p->left < len + 1)
+	{
+		size_t size = len + 1 + sizeof(char *) > STRPOOL_BLOCK
+			? len + 1 + sizeof(char *) : STRPOOL_BLOCK;
+		if (!(block = malloc(size)))
+			return NULL;
+		*(char **)block = p->blocks;
+		p->blocks = block;
+		p->next = block + sizeof(char *);
+		p->left = size - sizeof(char *);
+	}
+	copy = p->next;
+	memcpy(copy, s, len);
+	copy[len] = '\0';
+	p->next += len + 1;
+	p->left -= len + 1;
+	return copy;
+}
+
+void strpool_free(t_strpool *p)
+{
+	char *prev;
+
+	while (p->blocks)
+	{
+		prev = *(char **)p->blocks;
+		free(p->blocks);
+		p->blocks = prev;
+	}
+	p->next = NULL;
+	p->left = 0;
+}
+
+/*
+** strmap_init
+**
+** Description:
+**   Prepares an empty index over records of `stride` bytes whose uint32_t
+**   hash and string key are at `hash_off` and `key_off`.
+*/
+void strmap_init(t_strmap *m, size_t stride, size_t hash_off, size_t key_off)
+{
+	memset(m, 0, sizeof(*m));
+	m->stride = stride;
+	m->hash_off = hash_off;
+	m->key_off = key_off;
+}
+
+static uint32_t strmap_hash(const t_strmap *m, const void *records, size_t i)
+{
+	return *(const uint32_t *)((const char *)records + i * m->stride + m->hash_off);
+}
+
+static const char *strmap_key(const t_strmap *m, const void *records, size_t i)
+{
+	return *(const char *const *)((const char *)records + i * m->stride + m->key_off);
+}
+
+/*
+** strmap_reserve
+**
+** Description:
+**   Makes room for one record more than the `count` already indexed,
+**   doubling the slot array and re-inserting every record from its stored
+**   hash when it would be more than half full. Returns -1 if memory ran
+**   out.
+*/
+int strmap_reserve(t_strmap *m, const void *records, size_t count)
+{
+	size_t		nslots;
+	uint32_t	*slots;
+	size_t		s;
+
+	if ((count + 1) * 2 <= m->nslots)
+		return 0;
+	nslots = m->nslots ? m->nslots * 2 : STRMAP_MIN_SLOTS;
+	if (!(slots = calloc(nslots, sizeof(uint32_t))))
+		return -1;
+	for (size_t i = 0; i < count; i++)
+	{
+		s = strmap_hash(m, records, i) & (nslots - 1);
+		while (slots[s])
+			s = (s + 1) & (nslots - 1);
+		slots[s] = i + 1;
+	}
+	free(m->slots);
+	m->slots = slots;
+	m->nslots = nslots;
+	return 0;
+}
+
+/*
+** strmap_find
+**
+** Description:
+**   Slot of `key` in a non-empty index: the one holding its record, or
+**   the empty one where it would go.
+*/
+size_t strmap_find(const t_strmap *m, const void *records, const char *key, uint32_t hash)
+{
+	size_t s = hash & (m->nslots - 1);
+
+	while (m->slots[s])
+	{
+		if (strmap_hash(m, records, m->slots[s] - 1) == hash
+			&& strcmp(strmap_key(m, records, m->slots[s] - 1), key) == 0)
+			return s;
+		s = (s + 1) & (m->nslots - 1);
+	}
+	return s;
+}
+
+void strmap_free(t_strmap *m)
+{
+	free(m->slots);
+	m->slots = NULL;
+	m->nslots = 0;
+}
@@ -0,0 +1,158 @@
+#include "nm.h"
+
+/*
+** Symbol sets
+**
+** Description:
+**   The symbols of one table are kept as parallel arrays: a 32-bit name
+**   reference, the address, the letter, the section index, with -D the
+**   version code, with -S or --size-sort the size, with --format=json or
+**   csv the raw st_info, and the print order computed by sort(). A name
+**   reference is an offset into the table's string table, an offset into
+**   .shstrtab with SYMSET_SHSTRTAB set (unnamed section symbols under -a),
+**   or one of the two constants for "(null)" and "". A version code is the
+**   index of the version name with VERSION_HIDDEN set for a single '@'; 0
+**   means no suffix.
+**
+** Why:
+**   A t_sym is 56 bytes, mostly pointers. The arrays take 19 bytes per
+**   symbol (21 with -D, 8 more with sizes, 1 more with st_info), each pass
+**   reads only the arrays it needs, and sorting produces a 32-bit index
+**   permutation instead of moving structs.
+*/
+
+/*
+** symset_alloc
+**
+** Description:
+**   Reserves room for `count` symbols in the thread's arena. The version
+**   array is only reserved with `versions`, the size array with `sizes`,
+**   the st_info array with `infos`. Returns -1 on failure.
+*/
+int symset_alloc(t_symset *set, size_t count, bool versions, bool sizes, bool infos)
+{
+	set->count = 0;
+	set->name = arena_alloc(sizeof(uint32_t) * count);
+	set->addr = arena_alloc(sizeof(uint64_t) * count);
+	set->size = sizes ? arena_alloc(sizeof(uint64_t) * count) : NULL;
+	set->letter = arena_alloc(count);
+	set->shndx = arena_alloc(sizeof(uint16_t) * count);
+	set->version = versions ? arena_alloc(sizeof(uint16_t) * count) : NULL;
+	set->info = infos ? arena_alloc(count) : NULL;
+	set->secnames = NULL;
+	set->nsecnames = 0;
+	set->order = NULL;
+	set->coll = NULL;
+	if (!set->name || !set->addr || !set->letter || !set->shndx
+		|| (versions && !set->version) || (sizes && !set->size) || (infos && !set->info))
+		return -1;
+	return 0;
+}
+
+/*
+** symset_name_at
+**
+** Description:
+**   Decodes a name reference against a string table and .shstrtab.
+*/
+char *symset_name_at(char *strtab, char *shstrtab, uint32_t ref)
+{
+	if (ref == SYMSET_NULL_NAME)
+		return "(null)";
+	if (ref == SYMSET_EMPTY_NAME)
+		return "";
+	if (ref & SYMSET_SHSTRTAB)
+		return shstrtab + (ref & ~SYMSET_SHSTRTAB);
+	return strtab + ref;
+}
+
+char *symset_name(const t_symset *set, size_t i)
+{
+	return symset_name_at(set->strtab, set->shstrtab, set->name[i]);
+}
+
+/*
+** version_name
+**
+** Description:
+**   Decodes a non-zero version code against a file's version table.
+*/
+char *version_name(char **names, size_t count, uint16_t code)
+{
+	uint16_t vernum = code & ~VERSION_HIDDEN;
+
+	return (vernum < count && names[vernum]) ? names[vernum] : "<corrupt>";
+}
+
+/*
+** section_name
+**
+** Description:
+**   Name of section `shndx` against a file's section names, or the
+**   objdump name of a reserved index: *UND*, *ABS* and *COM*.
+*/
+char *section_name(char **names, size_t count, uint16_t shndx)
+{
+	if (shndx == SHN_UNDEF)
+		return "*UND*";
+	if (shndx == SHN_ABS)
+		return "*ABS*";
+	if (shndx == SHN_COMMON)
+		return "*COM*";
+	return (shndx < count && names[shndx]) ? names[shndx] : "";
+}
+
+/*
+** symset_row
+**
+** Description:
+**   Materializes symbol `i` as a t_sym, for the code that works one
+**   listing line at a time (the index cache).
+*/
+void symset_row(const t_symset *set, size_t i, t_sym *row)
+{
+	uint16_t code = set->version ? set->version[i] : 0;
+
+	row->name = symset_name(set, i);
+	row->addr = set->addr[i];
+	row->size = set->size ? set->size[i] : 0;
+	row->letter = set->letter[i];
+	row->shndx = set->shndx[i];
+	row->version = code ? version_name(set->vernames, set->nvernames, code) : NULL;
+	row->version_hidden = (code & VERSION_HIDDEN) != 0;
+	row->info = set->info ? set->info[i] : 0;
+	row->section = set->secnames ? section_name(set->secnames, set->nsecnames, row->shndx) : NULL;
+}
+
+/*
+** symset_at
+**
+** Description:
+**   Index of the `k`-th symbol in print order.
+*/
+size_t symset_at(const t_symset *set, size_t k)
+{
+	return set->order ? set->order[k] : k;
+}
+
+/*
+** symset_move
+**
+** Description:
+**   Moves symbols [src, src + n) down to `dst`, in every array.
+*/
+void symset_move(t_symset *set, size_t dst, size_t src, size_t n)
+{
+	if (dst == src || n == 0)
+		return;
+	memmove(set->name + dst, set->name + src, sizeof(uint32_t) * n);
+	memmove(set->addr + dst, set->addr + src, sizeof(uint64_t) * n);
+	if (set->size)
+		memmove(set->size + dst, set->size + src, sizeof(uint64_t) * n);
+	memmove(set->letter + dst, set->letter + src, n);
+	memmove(set->shndx + dst, set->shndx + src, sizeof(uint16_t) * n);
+	if (set->version)
+		memmove(set->version + dst, set->version + src, sizeof(uint16_t) * n);
+	if (set->info)
+		memmove(set->info + dst, set->info + src, n);
+}
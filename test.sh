@@ -7,11 +7,11 @@ NC='\033[0m'
 
 for file in test/*; do
     echo -n "Comparing $file... "
-    # Use LC_ALL=C to enforce ASCII sorting for nm to match ft_nm/strcmp behavior
+    # Both sort in the user's collation; LC_ALL=C keeps the expected output the same on every machine
     # Redirect stderr to /dev/null to ignore errors on invalid files
     # Filter out "bfd plugin" messages which oddly appear on stdout on some systems
     LC_ALL=C nm $file 2>/dev/null | grep -v "bfd plugin" > nm_output.txt
-    ./ft_nm $file > ft_nm_output.txt 2>/dev/null
+    LC_ALL=C ./ft_nm $file > ft_nm_output.txt 2>/dev/null
     
     DIFF=$(diff nm_output.txt ft_nm_output.txt)
     if [ "$DIFF" != "" ]; then
@@ -25,12 +25,12 @@ done
 
 echo -e "\n\nAll tests completed. Now doing it with bonus options."
 
-bonus_flags=("-r" "-a" "-g" "-p" "-u")
+bonus_flags=("-r" "-a" "-g" "-p" "-u" "-D" "-S" "--size-sort" "-n" "-nr" "-P" "-C")
 for file in test/*; do
     echo -n "Comparing $file... "
     for flags in "${bonus_flags[@]}"; do
         LC_ALL=C nm "$flags" "$file" 2>/dev/null | grep -v "bfd plugin" > nm_output.txt
-        ./ft_nm "$flags" "$file" > ft_nm_output.txt 2>/dev/null
+        LC_ALL=C ./ft_nm "$flags" "$file" > ft_nm_output.txt 2>/dev/null
 
         DIFF=$(diff nm_output.txt ft_nm_output.txt)
         if [ "$DIFF" != "" ]; then
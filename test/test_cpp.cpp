@@ -0,0 +1,68 @@
+// C++ symbols for the -C test: namespaces, classes, overloads, templates
+// and operators, mangled by the Itanium ABI
+#include <cstddef>
+
+namespace shapes
+{
+	struct Point
+	{
+		int x;
+		int y;
+
+		Point(int x, int y);
+		~Point();
+		Point operator+(const Point &other) const;
+		bool operator==(const Point &other) const;
+	};
+
+	Point::Point(int x, int y) : x(x), y(y) {}
+	Point::~Point() {}
+
+	Point Point::operator+(const Point &other) const
+	{
+		return Point(x + other.x, y + other.y);
+	}
+
+	bool Point::operator==(const Point &other) const
+	{
+		return x == other.x && y == other.y;
+	}
+
+	class Shape
+	{
+	public:
+		virtual ~Shape() {}
+		virtual double area() const = 0;
+	};
+
+	class Square : public Shape
+	{
+		double side;
+
+	public:
+		explicit Square(double side) : side(side) {}
+		double area() const { return side * side; }
+	};
+
+	static int g_count = 0;
+	int count() { return g_count; }
+}
+
+template <typename T>
+T biggest(const T *values, std::size_t n)
+{
+	T best = values[0];
+
+	for (std::size_t i = 1; i < n; i++)
+		if (values[i] > best)
+			best = values[i];
+	return best;
+}
+
+template int biggest<int>(const int *, std::size_t);
+template double biggest<double>(const double *, std::size_t);
+
+int scale(int value) { return value * 2; }
+double scale(double value, int times) { return value * times; }
+void *make_shape(double side) { return new shapes::Square(side); }
+extern "C" int plain_c(void) { return 42; }
@@ -15,18 +15,31 @@ int	ft_strncmp(const char *first, const char *second, size_t length)
 	return (0);
 }
 
+/*
+** ft_putstr_fd
+**
+** Description:
+**   Writes `s` to `fd`. Standard output goes through the output buffer;
+**   anything else flushes that buffer first so that messages keep their
+**   relative order, then is written in one go. Inside a -j worker both
+**   streams are captured (see out_capture and out_err).
+*/
 void	ft_putstr_fd(int fd, char *s)
 {
-	int	i;
-
 	if (!s)
 		return ;
-	i = 0;
-	while (s[i])
+	if (fd == 1)
 	{
-		write(fd, &s[i], 1);
-		i++;
+		out_str(out_stdout(), s);
+		return ;
 	}
+	if (fd == 2)
+	{
+		out_err(s, ft_strlen(s));
+		return ;
+	}
+	out_flush(out_stdout());
+	write(fd, s, ft_strlen(s));
 }
 
 size_t	ft_strlen(const char *theString)
@@ -51,6 +64,67 @@ bool str_is_nullterm(const char *start, const char *end)
 	return false;
 }
 
+/*
+** sym_shown
+**
+** Description:
+**   Whether a symbol passes the -u and -g filters. --size-sort, like
+**   binutils, only lists defined, non-absolute symbols with a size, and
+**   --start-address/--stop-address defined symbols in [start, stop).
+*/
+bool sym_shown(unsigned char letter, uint16_t shndx, uint64_t addr, uint64_t size,
+	t_nm_flags flags)
+{
+	if (flags.u && shndx != SHN_UNDEF)
+		return false;
+	if (flags.g && (letter >= 'a' && letter <= 'z')
+		&& letter != 'w' && letter != 'v'
+		&& letter != 'i' && letter != 'u')
+		return false;
+	if (flags.size_sort && (shndx == SHN_UNDEF || shndx == SHN_ABS || size == 0))
+		return false;
+	if (flags.range && (shndx == SHN_UNDEF || addr < flags.start_address || addr >= flags.stop_address))
+		return false;
+	return true;
+}
+
+/*
+** print_line
+**
+** Description:
+**   Prints one listing line: the address (blank for undefined symbols),
+**   with -S the size when it is not zero, the letter, the name and the
+**   version suffix if there is one. --size-sort without -S prints the
+**   size instead of the address.
+*/
+static inline void print_line(t_out *out, int width, uint64_t addr, uint64_t size,
+	unsigned char letter, uint16_t shndx, const char *name, const char *version,
+	bool hidden, t_nm_flags flags)
+{
+	if (shndx == SHN_UNDEF)
+		out_blank(out, width);
+	else
+	{
+		out_hex(out, (flags.size_sort && !flags.print_size) ? size : addr, width);
+		if (flags.print_size && size)
+		{
+			out_putc(out, ' ');
+			out_hex(out, size, width);
+		}
+	}
+	out_putc(out, ' ');
+	out_putc(out, letter);
+	out_putc(out, ' ');
+	out_str(out, name);
+	if (version)
+	{
+		// hidden or undefined: name@VERSION, default definition: name@@VERSION
+		out_str(out, (hidden || shndx == SHN_UNDEF) ? "@" : "@@");
+		out_str(out, version);
+	}
+	out_putc(out, '\n');
+}
+
 /*
 ** printTable
 **
@@ -61,38 +135,134 @@ bool str_is_nullterm(const char *start, const char *end)
 ** Why:
 **   We need to display the results to stdout. This function handles formatting
 **   addresses (padding), the type character, and the symbol name. It also respects filters like -u or -g.
+**   The other formats are printed by format_line (see format.c). With -C
+**   the names of the printed lines are demangled (see demangle.c).
 */
 void printTable(t_sym *tab, size_t tab_size, t_nm_flags flags, int bits)
 {
+	t_out	*out = out_stdout();
+	int		width = (bits == 32) ? 8 : 16;
+	size_t	printed = 0;
+	t_sym	row;
+
 	for (size_t i = 0; i < tab_size; i++)
 	{
-		if (flags.u && tab[i].shndx != SHN_UNDEF)
-			continue;
-		
-		if (flags.g && (tab[i].letter >= 'a' && tab[i].letter <= 'z') 
-			&& tab[i].letter != 'w' && tab[i].letter != 'v')
+		if (!sym_shown(tab[i].letter, tab[i].shndx, tab[i].addr, tab[i].size, flags))
 			continue;
-
-		if (tab[i].shndx == SHN_UNDEF)
-		{
-			if (bits == 32)
-				ft_putstr_fd(1, "        ");
-			else
-				ft_putstr_fd(1, "                ");
-			ft_putstr_fd(1, " ");
-			write(1, &tab[i].letter, 1);
-			ft_putstr_fd(1, " ");
-			ft_putstr_fd(1, tab[i].name);
-			ft_putstr_fd(1, "\n");
-		}
+		row = tab[i];
+		if (flags.demangle)
+			row.name = (char *)demangle_name(flags.demangle_table, row.name);
+		if (flags.format != FORMAT_BSD)
+			format_line(out, &row, flags);
 		else
+			print_line(out, width, row.addr, row.size, row.letter, row.shndx,
+				row.name, row.version, row.version_hidden, flags);
+		printed++;
+	}
+	stats_add(STATS_PRINTED, printed);
+}
+
+// printed lines per part of a split demangling, see demangle_batch
+#define DEMANGLE_BATCH ((size_t)1 << 12)
+
+typedef struct s_demangle_split {
+	const t_symset	*set;
+	t_nm_flags		flags;
+	size_t			lo;
+	size_t			n;
+	const char		**names;
+}	t_demangle_split;
+
+static void demangle_part(void *ctx, int part, int parts)
+{
+	t_demangle_split	*d = ctx;
+	const t_symset		*set = d->set;
+	size_t				i;
+
+	for (size_t k = split_bound(d->n, part, parts); k < split_bound(d->n, part + 1, parts); k++)
+	{
+		i = symset_at(set, d->lo + k);
+		if (sym_shown(set->letter[i], set->shndx[i], set->addr[i], set->size ? set->size[i] : 0, d->flags))
+			d->names[k] = demangle_name(d->flags.demangle_table, symset_name(set, i));
+	}
+}
+
+/*
+** demangle_batch
+**
+** Description:
+**   With -C, demangles the names of the lines of [lo, hi) of the print
+**   order that will be printed, in parallel when there are many of them.
+**   Returns the names, indexed from lo, or NULL when printSet should
+**   demangle line by line instead.
+**
+** Why:
+**   Decoding a C++ name costs as much as walking many symbols, so parts
+**   are DEMANGLE_BATCH lines long rather than SPLIT_MIN symbols.
+*/
+static const char **demangle_batch(const t_symset *set, t_nm_flags flags, size_t lo, size_t hi)
+{
+	t_demangle_split	d;
+	int					parts;
+
+	if (!flags.demangle)
+		return NULL;
+	parts = split_count((hi - lo) / DEMANGLE_BATCH * SPLIT_MIN, flags);
+	if (parts == 1 || !(d.names = arena_alloc(sizeof(char *) * (hi - lo))))
+		return NULL;
+	d.set = set;
+	d.flags = flags;
+	d.lo = lo;
+	d.n = hi - lo;
+	run_split(parts, demangle_part, &d);
+	return d.names;
+}
+
+/*
+** printSet
+**
+** Description:
+**   printTable for a symbol set (see symset.c), in its print order. With
+**   -n, an address range only walks its slice of the order.
+*/
+void printSet(const t_symset *set, t_nm_flags flags, int bits)
+{
+	t_out		*out = out_stdout();
+	int			width = (bits == 32) ? 8 : 16;
+	size_t		printed = 0;
+	size_t		i;
+	uint16_t	code;
+	uint64_t	size;
+	size_t		lo;
+	size_t		hi;
+	t_sym		row;
+	const char	**names;
+	const char	*name;
+
+	sort_range(set, flags, &lo, &hi);
+	names = demangle_batch(set, flags, lo, hi);
+	for (size_t k = lo; k < hi; k++)
+	{
+		i = symset_at(set, k);
+		size = set->size ? set->size[i] : 0;
+		if (!sym_shown(set->letter[i], set->shndx[i], set->addr[i], size, flags))
+			continue;
+		name = names ? names[k - lo] : symset_name(set, i);
+		if (flags.demangle && !names)
+			name = demangle_name(flags.demangle_table, name);
+		if (flags.format != FORMAT_BSD)
 		{
-			print_hex(tab[i].addr, (bits == 32) ? 8 : 16);
-			ft_putstr_fd(1, " ");
-			write(1, &tab[i].letter, 1);
-			ft_putstr_fd(1, " ");
-			ft_putstr_fd(1, tab[i].name);
-			ft_putstr_fd(1, "\n");
+			symset_row(set, i, &row);
+			row.name = (char *)name;
+			format_line(out, &row, flags);
+			printed++;
+			continue;
 		}
+		code = set->version ? set->version[i] : 0;
+		print_line(out, width, set->addr[i], size, set->letter[i], set->shndx[i], name,
+			code ? version_name(set->vernames, set->nvernames, code) : NULL, (code & VERSION_HIDDEN) != 0,
+			flags);
+		printed++;
 	}
+	stats_add(STATS_PRINTED, printed);
 }
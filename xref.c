@@ -0,0 +1,343 @@
+#include "nm.h"
+
+/*
+** Cross reference (--xref)
+**
+** Description:
+**   Instead of listing each input, every global symbol of every input
+**   (archive members included) is interned into one hash table of names
+**   shared by the whole run. Each name records its first strong definer,
+**   its first weak or common definer, the number of strong definitions
+**   and of references, and its first referencer. A report sorted by name
+**   is printed once all inputs are read:
+**     D NAME REFS FILE   defined once, in FILE
+**     W NAME REFS FILE   only weak, common or GNU unique definitions, the
+**                        first in FILE
+**     U NAME REFS FILE   never defined, first referenced by FILE
+**     M NAME REFS FILE   defined more than once: one line per definer
+**   REFS counts the undefined references to NAME. "First" is in command
+**   line order, then archive member order, whatever -j does. Weak
+**   undefined references are not reported: they may stay unresolved.
+**
+** Why:
+**   Finding out which file satisfies which undefined symbol, which ones
+**   nothing defines and which strong symbols collide used to take sort |
+**   join pipelines over the listings of a whole link. A name is stored
+**   once whatever the number of files that use it, so memory follows the
+**   number of unique names; only the extra definers of a conflict take a
+**   record of their own.
+*/
+
+/*
+** xref_init
+**
+** Description:
+**   Prepares an empty table and registers the `count` inputs named on the
+**   command line: input `i` gets file id `i`.
+*/
+int xref_init(t_xref *x, char **names, int count)
+{
+	memset(x, 0, sizeof(*x));
+	strmap_init(&x->map, sizeof(t_xref_name), offsetof(t_xref_name, hash), offsetof(t_xref_name, name));
+	pthread_mutex_init(&x->lock, NULL);
+	for (int i = 0; i < count; i++)
+		if (xref_member(x, XREF_NONE, i, names[i]) == XREF_NONE)
+			return -1;
+	return 0;
+}
+
+/*
+** xref_file_add
+**
+** Description:
+**   Appends a file to the file table, the lock being held. Returns its id,
+**   or XREF_NONE if memory is exhausted.
+*/
+static uint32_t xref_file_add(t_xref *x, uint32_t parent, int index, const char *name)
+{
+	t_xref_file	*f;
+	size_t		len = ft_strlen(name);
+	size_t		plen;
+
+	if (x->nfiles == x->files_cap)
+	{
+		size_t		cap = x->files_cap ? x->files_cap * 2 : 64;
+		t_xref_file	*grown = realloc(x->files, sizeof(t_xref_file) * cap);
+
+		if (!grown)
+			return XREF_NONE;
+		x->files = grown;
+		x->files_cap = cap;
+	}
+	f = &x->files[x->nfiles];
+	plen = parent == XREF_NONE ? 0 : ft_strlen(x->files[parent].name);
+	if (!(f->name = malloc(plen + len + 3)))
+		return XREF_NONE;
+	if (parent == XREF_NONE)
+	{
+		memcpy(f->name, name, len + 1);
+		f->top = index;
+		f->member = 0;
+	}
+	else
+	{
+		memcpy(f->name, x->files[parent].name, plen);
+		f->name[plen] = '(';
+		memcpy(f->name + plen + 1, name, len);
+		memcpy(f->name + plen + 1 + len, ")", 2);
+		f->top = x->files[parent].top;
+		f->member = index + 1;
+	}
+	return x->nfiles++;
+}
+
+/*
+** xref_member
+**
+** Description:
+**   Registers a file and returns its id, or XREF_NONE if memory is
+**   exhausted. With a `parent`, the file is member `index` of that archive
+**   and is named "archive(member)", like the linker does.
+*/
+uint32_t xref_member(t_xref *x, uint32_t parent, int index, const char *name)
+{
+	uint32_t id;
+
+	pthread_mutex_lock(&x->lock);
+	id = xref_file_add(x, parent, index, name);
+	pthread_mutex_unlock(&x->lock);
+	return id;
+}
+
+// whether file `a` comes before file `b` in the report's order
+static bool xref_before(t_xref *x, uint32_t a, uint32_t b)
+{
+	if (b == XREF_NONE)
+		return true;
+	if (x->files[a].top != x->files[b].top)
+		return x->files[a].top < x->files[b].top;
+	return x->files[a].member < x->files[b].member;
+}
+
+/*
+** xref_intern
+**
+** Description:
+**   Returns the record of `name`, creating it on first sight, or NULL if
+**   memory is exhausted.
+*/
+static t_xref_name *xref_intern(t_xref *x, const char *name)
+{
+	uint32_t	hash = gnu_hash(name);
+	size_t		s;
+	t_xref_name	*n;
+
+	if (strmap_reserve(&x->map, x->names, x->count) < 0)
+		return NULL;
+	s = strmap_find(&x->map, x->names, name, hash);
+	if (x->map.slots[s])
+		return &x->names[x->map.slots[s] - 1];
+	if (x->count == x->cap)
+	{
+		size_t		cap = x->cap ? x->cap * 2 : 1024;
+		t_xref_name	*grown = realloc(x->names, sizeof(t_xref_name) * cap);
+
+		if (!grown)
+			return NULL;
+		x->names = grown;
+		x->cap = cap;
+	}
+	n = &x->names[x->count];
+	if (!(n->name = strpool_dup(&x->pool, name, ft_strlen(name))))
+		return NULL;
+	n->hash = hash;
+	n->def = XREF_NONE;
+	n->weak = XREF_NONE;
+	n->ref = XREF_NONE;
+	n->ndefs = 0;
+	n->nrefs = 0;
+	n->dups = XREF_NONE;
+	x->map.slots[s] = ++x->count;
+	return n;
+}
+
+/*
+** xref_define
+**
+** Description:
+**   Records a strong definition of `n` by `file`. From the second one on,
+**   the later definer in report order goes to the conflict chain.
+*/
+static int xref_define(t_xref *x, t_xref_name *n, uint32_t file)
+{
+	uint32_t extra = file;
+
+	if (n->def != XREF_NONE)
+	{
+		if (x->ndups == x->dups_cap)
+		{
+			size_t		cap = x->dups_cap ? x->dups_cap * 2 : 64;
+			t_xref_dup	*grown = realloc(x->dups, sizeof(t_xref_dup) * cap);
+
+			if (!grown)
+				return -1;
+			x->dups = grown;
+			x->dups_cap = cap;
+		}
+		if (xref_before(x, file, n->def))
+		{
+			extra = n->def;
+			n->def = file;
+		}
+		x->dups[x->ndups].file = extra;
+		x->dups[x->ndups].next = n->dups;
+		n->dups = x->ndups++;
+	}
+	else
+		n->def = file;
+	n->ndefs++;
+	return 0;
+}
+
+/*
+** xref_add
+**
+** Description:
+**   Feeds the global symbols of one classified symbol table to the table.
+**   Returns -1 if memory is exhausted.
+*/
+int xref_add(t_xref *x, const t_symset *set, uint32_t file)
+{
+	t_xref_name		*n;
+	unsigned char	c;
+	int				ret = 0;
+
+	pthread_mutex_lock(&x->lock);
+	for (size_t i = 0; i < set->count && ret == 0; i++)
+	{
+		c = set->letter[i];
+		// locals, debug symbols and weak undefined references take no part
+		if (c != 'U' && c != 'C' && c != 'i' && c != 'u'
+			&& (c < 'A' || c > 'Z' || c == 'N' || c == 'I'))
+			continue;
+		if (!(n = xref_intern(x, symset_name(set, i))))
+			ret = -1;
+		else if (c == 'U')
+		{
+			n->nrefs++;
+			if (xref_before(x, file, n->ref))
+				n->ref = file;
+		}
+		// GNU unique symbols are merged by the linker, like weak ones
+		else if (c == 'W' || c == 'V' || c == 'C' || c == 'u')
+		{
+			if (xref_before(x, file, n->weak))
+				n->weak = file;
+		}
+		else
+			ret = xref_define(x, n, file);
+	}
+	pthread_mutex_unlock(&x->lock);
+	return ret;
+}
+
+static int xref_cmp(const void *a, const void *b)
+{
+	return strcmp(((const t_xref_name *)a)->name, ((const t_xref_name *)b)->name);
+}
+
+static void xref_line(t_out *out, char kind, t_xref_name *n, const char *file)
+{
+	char	tmp[10];
+	int		i = 10;
+	uint32_t refs = n->nrefs;
+
+	out_putc(out, kind);
+	out_putc(out, ' ');
+	out_str(out, n->name);
+	out_putc(out, ' ');
+	do
+		tmp[--i] = '0' + refs % 10;
+	while (refs /= 10);
+	out_write(out, tmp + i, 10 - i);
+	out_putc(out, ' ');
+	out_str(out, file);
+	out_putc(out, '\n');
+}
+
+/*
+** xref_conflict
+**
+** Description:
+**   Prints the M lines of a name defined more than once, definers in
+**   report order. The chain is short, so it is sorted by insertion.
+*/
+static int xref_conflict(t_xref *x, t_out *out, t_xref_name *n)
+{
+	uint32_t	*files = malloc(sizeof(uint32_t) * n->ndefs);
+	uint32_t	count = 0;
+	uint32_t	tmp;
+	uint32_t	j;
+
+	if (!files)
+		return -1;
+	files[count++] = n->def;
+	for (uint32_t d = n->dups; d != XREF_NONE; d = x->dups[d].next)
+	{
+		tmp = x->dups[d].file;
+		j = count++;
+		while (j > 0 && xref_before(x, tmp, files[j - 1]))
+		{
+			files[j] = files[j - 1];
+			j--;
+		}
+		files[j] = tmp;
+	}
+	for (uint32_t k = 0; k < count; k++)
+		xref_line(out, 'M', n, x->files[files[k]].name);
+	free(files);
+	return 0;
+}
+
+/*
+** xref_report
+**
+** Description:
+**   Prints the report (see the top of this file) to stdout. The table is
+**   not usable afterwards. Returns -1 if memory is exhausted.
+*/
+int xref_report(t_xref *x)
+{
+	t_out		*out = out_stdout();
+	t_xref_name	*n;
+
+	qsort(x->names, x->count, sizeof(t_xref_name), xref_cmp);
+	for (size_t i = 0; i < x->count; i++)
+	{
+		n = &x->names[i];
+		if (n->ndefs > 1)
+		{
+			if (xref_conflict(x, out, n) < 0)
+				return -1;
+		}
+		else if (n->ndefs == 1)
+			xref_line(out, 'D', n, x->files[n->def].name);
+		else if (n->weak != XREF_NONE)
+			xref_line(out, 'W', n, x->files[n->weak].name);
+		else
+			xref_line(out, 'U', n, x->files[n->ref].name);
+	}
+	return 0;
+}
+
+void xref_free(t_xref *x)
+{
+	strpool_free(&x->pool);
+	for (size_t i = 0; i < x->nfiles; i++)
+		free(x->files[i].name);
+	free(x->files);
+	free(x->names);
+	strmap_free(&x->map);
+	free(x->dups);
+	pthread_mutex_destroy(&x->lock);
+}